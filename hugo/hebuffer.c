@@ -29,6 +29,17 @@ Then:
 NOTES:	All TB_*() calls are done in individual units, i.e., in
 	characters if the port is character-based or in pixels if
 	the port is pixel-based.
+
+	Up to MAX_TEXTBUFFER_COUNT words are kept; the oldest one is
+	dropped to make room for a new one.  Their text is kept in a
+	single arena of TEXTBUFFER_ARENA_SIZE bytes.  Both can be
+	#defined by the port.
+
+	Words are grouped into rows of words sharing the same top
+	coordinate, so that scrolling usually only has to move whole
+	rows.  The rows are kept sorted by their top coordinate, so
+	that finding a word only has to look at the rows just above
+	it.
 */
 
 #include "heheader.h"
@@ -36,12 +47,21 @@ NOTES:	All TB_*() calls are done in individual units, i.e., in
 #ifdef USE_TEXTBUFFER
 
 #ifndef MAX_TEXTBUFFER_COUNT
-#define MAX_TEXTBUFFER_COUNT 1000
+#define MAX_TEXTBUFFER_COUNT 4000
+#endif
+
+#ifndef TEXTBUFFER_ARENA_SIZE
+#define TEXTBUFFER_ARENA_SIZE (MAX_TEXTBUFFER_COUNT*16)
 #endif
 
 #define TB_NONE (-1)
 #define WINDOW_CELL " _win"
 
+/* Results of TB_RowInBounds() */
+#define TB_NO_CELLS	0
+#define TB_ALL_CELLS	1
+#define TB_SOME_CELLS	2
+
 char allow_text_selection = true;
 
 int tb_first_used;		/* indexes */
@@ -54,17 +74,60 @@ int tb_unused;
 
 typedef struct
 {
-	char *data;
-	int left, top, right, bottom;
-	int prev, next;
+	int data;		/* offset in tb_arena, or TB_NONE */
+	int left, right;
+	int height;		/* bottom - top */
+	int row;		/* the top is the row's */
+	int prev, next;		/* oldest to newest */
+	int rowprev, rownext;	/* other cells in the same row */
+	unsigned long age;
+	char window;		/* a WINDOW_CELL */
 #ifdef TEXTBUFFER_FORMATTING
 	int font, fcolor, bgcolor;
 #endif
 } tb_list_struct;
 tb_list_struct tb_list[MAX_TEXTBUFFER_COUNT];
 
+/* Cells sharing the same top coordinate.  The min/max values are
+   only ever widened while the row is in use, so they may be looser
+   than the cells actually in the row.
+*/
+typedef struct
+{
+	int top;
+	int first;		/* first cell in the row */
+	int count;
+	int pos;		/* in tb_active_rows[] */
+	int windows;		/* WINDOW_CELLs in the row */
+	int minleft, maxleft, minright, maxright;
+	int minheight, maxheight;
+} tb_row_struct;
+static tb_row_struct tb_rows[MAX_TEXTBUFFER_COUNT];
+static int tb_active_rows[MAX_TEXTBUFFER_COUNT];	/* by top */
+static int tb_free_rows[MAX_TEXTBUFFER_COUNT];
+static int tb_active_count, tb_free_count;
+static int tb_last_row = TB_NONE;	/* where the last word went */
+static int tb_max_height = 0;		/* of any row since TB_Init() */
+
+/* Cells waiting to be moved to another row by TB_Scroll() */
+static int tb_moving[MAX_TEXTBUFFER_COUNT];
+
+static char tb_arena[TEXTBUFFER_ARENA_SIZE];
+static int tb_arena_used = 0;
+static unsigned long tb_age = 0;
+
 int tb_selected;
 
+#define TB_TOP(n)	(tb_rows[tb_list[n].row].top)
+#define TB_BOTTOM(n)	(TB_TOP(n)+tb_list[n].height)
+#define TB_DATA(n)	(tb_arena+tb_list[n].data)
+
+static int TB_RowPos(int top);
+static void TB_SortRows(void);
+static int TB_AddToRow(int n, int top);
+static void TB_RemoveFromRow(int n);
+static int TB_RowInBounds(int r, int left, int top, int right, int bottom);
+
 
 /* TB_Init()
 
@@ -77,9 +140,10 @@ void TB_Init()
 
 	for (i=0; i<MAX_TEXTBUFFER_COUNT; i++)
 	{
-		tb_list[i].data = NULL;
+		tb_list[i].data = TB_NONE;
 		tb_list[i].prev = i?i-1:TB_NONE;
 		tb_list[i].next = (i<MAX_TEXTBUFFER_COUNT-1)?i+1:TB_NONE;
+		tb_free_rows[i] = MAX_TEXTBUFFER_COUNT-1-i;
 	}
 
 	tb_first_unused = 0;
@@ -88,6 +152,12 @@ void TB_Init()
 	tb_last_used = TB_NONE;
 	tb_used = 0;
 	tb_unused = MAX_TEXTBUFFER_COUNT;
+
+	tb_active_count = 0;
+	tb_free_count = MAX_TEXTBUFFER_COUNT;
+	tb_last_row = TB_NONE;
+	tb_max_height = 0;
+	tb_arena_used = 0;
 }
 
 
@@ -98,7 +168,7 @@ void TB_Init()
 
 char TB_IsUsed(int n)
 {
-	return (tb_list[n].data)?false:true;
+	return (tb_list[n].data!=TB_NONE)?true:false;
 }
 
 
@@ -114,6 +184,164 @@ int TB_FirstCell()
 }
 
 
+/* TB_RowPos(top)
+
+	Returns the position in tb_active_rows[] of the first row
+	whose top is at or below <top>, or tb_active_count if there
+	isn't one.
+*/
+
+static int TB_RowPos(int top)
+{
+	int lo = 0, hi = tb_active_count, mid;
+
+	while (lo < hi)
+	{
+		mid = (lo+hi)/2;
+		if (tb_rows[tb_active_rows[mid]].top < top)
+			lo = mid+1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+
+/* TB_SortRows()
+
+	Puts tb_active_rows[] back in order after the tops of some
+	rows have been changed.  They're never far out of order, so
+	this is an insertion sort.
+*/
+
+static void TB_SortRows(void)
+{
+	int i, k, r;
+
+	for (i=1; i<tb_active_count; i++)
+	{
+		r = tb_active_rows[i];
+		for (k=i; k>0 && tb_rows[tb_active_rows[k-1]].top > tb_rows[r].top; k--)
+		{
+			tb_active_rows[k] = tb_active_rows[k-1];
+			tb_rows[tb_active_rows[k]].pos = k;
+		}
+		tb_active_rows[k] = r;
+		tb_rows[r].pos = k;
+	}
+}
+
+
+/* TB_AddToRow(n, top)
+
+	Puts cell n in the row at <top>, starting a new row if there
+	isn't one.  Returns the row.
+*/
+
+static int TB_AddToRow(int n, int top)
+{
+	int i, k, r = TB_NONE;
+	tb_row_struct *row;
+
+	/* Words are mostly added to the same line as the last one */
+	if (tb_last_row!=TB_NONE && tb_rows[tb_last_row].count &&
+		tb_rows[tb_last_row].top==top)
+	{
+		r = tb_last_row;
+	}
+	else
+	{
+		k = TB_RowPos(top);
+		if (k<tb_active_count && tb_rows[tb_active_rows[k]].top==top)
+			r = tb_active_rows[k];
+	}
+
+	if (r==TB_NONE)
+	{
+		/* There are as many rows as cells, so there's always one */
+		r = tb_free_rows[--tb_free_count];
+		row = &tb_rows[r];
+		row->top = top;
+		row->first = TB_NONE;
+		row->count = 0;
+		row->windows = 0;
+
+		/* Keep the rows in order */
+		for (i=tb_active_count++; i>k; i--)
+		{
+			tb_active_rows[i] = tb_active_rows[i-1];
+			tb_rows[tb_active_rows[i]].pos = i;
+		}
+		row->pos = k;
+		tb_active_rows[k] = r;
+	}
+	row = &tb_rows[r];
+
+	if (row->count==0)
+	{
+		row->minleft = row->maxleft = tb_list[n].left;
+		row->minright = row->maxright = tb_list[n].right;
+		row->minheight = row->maxheight = tb_list[n].height;
+	}
+	else
+	{
+		if (tb_list[n].left < row->minleft) row->minleft = tb_list[n].left;
+		if (tb_list[n].left > row->maxleft) row->maxleft = tb_list[n].left;
+		if (tb_list[n].right < row->minright) row->minright = tb_list[n].right;
+		if (tb_list[n].right > row->maxright) row->maxright = tb_list[n].right;
+		if (tb_list[n].height < row->minheight) row->minheight = tb_list[n].height;
+		if (tb_list[n].height > row->maxheight) row->maxheight = tb_list[n].height;
+	}
+	if (row->maxheight > tb_max_height) tb_max_height = row->maxheight;
+
+	tb_list[n].row = r;
+	tb_list[n].rowprev = TB_NONE;
+	tb_list[n].rownext = row->first;
+	if (row->first!=TB_NONE)
+		tb_list[row->first].rowprev = n;
+	row->first = n;
+	row->count++;
+	if (tb_list[n].window) row->windows++;
+
+	tb_last_row = r;
+	return r;
+}
+
+
+/* TB_RemoveFromRow(n)
+
+	Takes cell n out of its row, and the row out of use if that
+	was the last cell in it.
+*/
+
+static void TB_RemoveFromRow(int n)
+{
+	int r = tb_list[n].row, i;
+	tb_row_struct *row = &tb_rows[r];
+
+	if (tb_list[n].rowprev!=TB_NONE)
+		tb_list[tb_list[n].rowprev].rownext = tb_list[n].rownext;
+	else
+		row->first = tb_list[n].rownext;
+	if (tb_list[n].rownext!=TB_NONE)
+		tb_list[tb_list[n].rownext].rowprev = tb_list[n].rowprev;
+
+	if (tb_list[n].window) row->windows--;
+
+	if (--row->count==0)
+	{
+		/* Keep the rows in order */
+		tb_active_count--;
+		for (i=row->pos; i<tb_active_count; i++)
+		{
+			tb_active_rows[i] = tb_active_rows[i+1];
+			tb_rows[tb_active_rows[i]].pos = i;
+		}
+		tb_free_rows[tb_free_count++] = r;
+	}
+}
+
+
 /* TB_Remove(int n, list)
 
 	Removes the specified word cell (at index n) from either
@@ -135,14 +363,14 @@ void TB_Remove(int n)
 	tb_used--;
 
 	/* Free this cell (TB_IsUsed() sanity check just in case) */
-	if (!TB_IsUsed(n))
+	if (TB_IsUsed(n))
 	{
 #ifdef TB_DEBUG
 		printf("TB_Remove(): freeing tb_list[%d]: '%s', tb_used=%d\n",
-			n, tb_list[n].data, tb_used);
+			n, TB_DATA(n), tb_used);
 #endif
-		hugo_blockfree(tb_list[n].data);
-		tb_list[n].data = NULL;
+		TB_RemoveFromRow(n);
+		tb_list[n].data = TB_NONE;
 	}
 #ifdef TB_DEBUG
 	else
@@ -159,6 +387,32 @@ void TB_Remove(int n)
 		tb_first_unused = n;
 	tb_last_unused = n;
 	tb_unused++;
+
+	/* Nothing left in the arena worth keeping */
+	if (tb_used==0) tb_arena_used = 0;
+}
+
+
+/* TB_Compact()
+
+	Moves the text of all used cells to the start of the arena.
+	Text is always added at the end, oldest cell first, so this
+	never overwrites text that hasn't been moved yet.
+*/
+
+static void TB_Compact(void)
+{
+	int i, len, pos = 0;
+
+	for (i=tb_first_used; i!=TB_NONE; i=tb_list[i].next)
+	{
+		len = strlen(TB_DATA(i)) + 1;
+		if (tb_list[i].data!=pos)
+			memmove(tb_arena+pos, TB_DATA(i), len);
+		tb_list[i].data = pos;
+		pos += len;
+	}
+	tb_arena_used = pos;
 }
 
 
@@ -171,7 +425,7 @@ void TB_Remove(int n)
 
 int TB_AddWord(char *w, int left, int top, int right, int bottom)
 {
-	int i, c;
+	int i, c, len;
 	int n;
 	
 #ifdef MINIMAL_WINDOWING
@@ -188,6 +442,15 @@ int TB_AddWord(char *w, int left, int top, int right, int bottom)
 		if (w[0]=='\0') return TB_NONE;
 	}
 
+	/* Font/color change codes aren't stored */
+	len = 0;
+	for (i=0; w[i]!='\0'; i++)
+	{
+		if ((unsigned char)w[i]>=' ') len++;
+	}
+	if (len+1 > TEXTBUFFER_ARENA_SIZE)
+		return TB_NONE;
+
 	/* If we've used everything, use the oldest used cell */
 	if (tb_used >= MAX_TEXTBUFFER_COUNT)
 	{
@@ -197,31 +460,23 @@ int TB_AddWord(char *w, int left, int top, int right, int bottom)
 		TB_Remove(tb_first_used);
 	}
 
-	/* Get the cell we're going to add */
-	n = tb_first_unused;
-
-	/* Try to allocate storage for the word */
-	if (!(tb_list[n].data = hugo_blockalloc(strlen(w)+1)))
+	/* Make room in the arena, dropping older cells if we have to */
+	if (tb_arena_used+len+1 > TEXTBUFFER_ARENA_SIZE)
 	{
-		/* If we fail, try to free older used cells */
-		while (tb_used)
+		TB_Compact();
+		while (tb_arena_used+len+1 > TEXTBUFFER_ARENA_SIZE)
 		{
 #ifdef TB_DEBUG
-			printf("TB_AddWord(): Initial alloc failed (tb_used = %d)\n", tb_used);
+			printf("TB_AddWord(): Arena full (tb_used = %d)\n", tb_used);
 #endif
 			TB_Remove(tb_first_used);
-			if ((tb_list[n].data = hugo_blockalloc(strlen(w)+1)))
-				break;
-		}
-		if (tb_used==0)
-		{
-#ifdef TB_DEBUG
-			printf("TB_AddWord(): Unable to allocate for '%s'\n", w);
-#endif
-			return TB_NONE;
+			TB_Compact();
 		}
 	}
 
+	/* Get the cell we're going to add */
+	n = tb_first_unused;
+
 	/* Take the cell out of the unused list */
 	if (tb_list[n].prev != TB_NONE)
 		tb_list[tb_list[n].prev].next = tb_list[n].next;
@@ -244,22 +499,24 @@ int TB_AddWord(char *w, int left, int top, int right, int bottom)
 	tb_last_used = n;
 	tb_used++;
 	
-	/* Set its coordinates */
-	
 	/* Just using strcpy() will let font/color change codes through */
-	/* strcpy(tb_list[n].data, w); */
+	tb_list[n].data = tb_arena_used;
 	c = 0;
-	for (i=0; i<(int)strlen(w); i++)
+	for (i=0; w[i]!='\0'; i++)
 	{
 		if ((unsigned char)w[i]>=' ')
-			tb_list[n].data[c++] = w[i];
+			tb_arena[tb_arena_used+c++] = w[i];
 	}
-	tb_list[n].data[c] = '\0';
-	
+	tb_arena[tb_arena_used+c] = '\0';
+	tb_arena_used += len+1;
+
+	/* Set its coordinates */
 	tb_list[n].left = left;
-	tb_list[n].top = top;
 	tb_list[n].right = right;
-	tb_list[n].bottom = bottom;
+	tb_list[n].height = bottom-top;
+	tb_list[n].window = !strcmp(TB_DATA(n), WINDOW_CELL);
+	tb_list[n].age = tb_age++;
+	TB_AddToRow(n, top);
 #ifdef TEXTBUFFER_FORMATTING
 	tb_list[n].font = currentfont;
 	tb_list[n].fcolor = fcolor;
@@ -294,10 +551,12 @@ int TB_AddWin(int left, int top, int right, int bottom)
 
 char TB_InBounds(int n, int left, int top, int right, int bottom)
 {
+	int celltop = TB_TOP(n), cellbottom = TB_BOTTOM(n);
+
 	if ((tb_list[n].left>=left && tb_list[n].left<=right &&
-		tb_list[n].top>=top && tb_list[n].top<=bottom) ||
+		celltop>=top && celltop<=bottom) ||
 		(tb_list[n].right>=left && tb_list[n].right<=right &&
-		tb_list[n].bottom>=top && tb_list[n].bottom<=bottom))
+		cellbottom>=top && cellbottom<=bottom))
 	{
 		return true;
 	}
@@ -305,6 +564,46 @@ char TB_InBounds(int n, int left, int top, int right, int bottom)
 }
 
 
+/* TB_RowInBounds(r, left, top, right, bottom)
+
+	Returns TB_ALL_CELLS or TB_NO_CELLS if TB_InBounds() would be
+	true or false (respectively) for every cell in row r, or
+	TB_SOME_CELLS if each cell has to be checked.
+*/
+
+static int TB_RowInBounds(int r, int left, int top, int right, int bottom)
+{
+	tb_row_struct *row = &tb_rows[r];
+
+	/* Neither corner can be within the left-right bounds */
+	if ((row->maxleft < left || row->minleft > right) &&
+		(row->maxright < left || row->minright > right))
+	{
+		return TB_NO_CELLS;
+	}
+
+	/* Unless both corners are, it's up to each cell */
+	if (row->minleft < left || row->maxleft > right ||
+		row->minright < left || row->maxright > right ||
+		row->minheight < 0)
+	{
+		return TB_SOME_CELLS;
+	}
+
+	/* Then it's just a matter of the top or bottom edge */
+	if (row->top>=top && row->top<=bottom)
+		return TB_ALL_CELLS;
+	if (row->top > bottom)
+		return TB_NO_CELLS;
+	if (row->top+row->minheight>=top && row->top+row->maxheight<=bottom)
+		return TB_ALL_CELLS;
+	if (row->top+row->maxheight < top || row->top+row->minheight > bottom)
+		return TB_NO_CELLS;
+
+	return TB_SOME_CELLS;
+}
+
+
 /* TB_Clear(left, top, right, bottom)
 
 	Removes all cells within the given boundaries.
@@ -312,7 +611,9 @@ char TB_InBounds(int n, int left, int top, int right, int bottom)
 
 void TB_Clear(int left, int top, int right, int bottom)
 {
-	int i = tb_first_used;
+	int i, k, r, next;
+	int in_bounds;
+	char remove_all;
 
 	/* right may be <0 when called from Printout() with
 	   only control characters in the string */
@@ -321,25 +622,37 @@ void TB_Clear(int left, int top, int right, int bottom)
 #ifdef TB_DEBUG
 	printf("TB_Clear(%d, %d, %d, %d)\n", left, top, right, bottom);
 #endif
-	while (i!=TB_NONE)
+	/* Rows go away (and the ones after them move down) as they're
+	   emptied, so go backwards
+	*/
+	for (k=tb_active_count-1; k>=0; k--)
 	{
-		/* Have to find out what the next cell is
-		   before we remove this current one */
-		int next = tb_list[i].next;
-
-		if (TB_InBounds(i, left, top, right, bottom))
+		if (k >= tb_active_count) continue;
+		r = tb_active_rows[k];
+
+		/* Cells that are in bounds, off the top of the window or
+		   above the screen are all removed
+		*/
+		in_bounds = TB_RowInBounds(r, left, top, right, bottom);
+		remove_all = (in_bounds==TB_ALL_CELLS ||
+			tb_rows[r].top < physical_windowtop ||
+			tb_rows[r].top+tb_rows[r].maxheight < 0);
+
+		if (!remove_all && in_bounds==TB_NO_CELLS &&
+			tb_rows[r].top+tb_rows[r].minheight >= 0)
 		{
-			TB_Remove(i);
-			i = next;
 			continue;
 		}
-		if (tb_list[i].top < physical_windowtop
-			|| tb_list[i].bottom<0)
+
+		for (i=tb_rows[r].first; i!=TB_NONE; i=next)
 		{
-			TB_Remove(i);
+			next = tb_list[i].rownext;
+			if (remove_all || TB_InBounds(i, left, top, right, bottom) ||
+				TB_BOTTOM(i) < 0)
+			{
+				TB_Remove(i);
+			}
 		}
-
-		i = next;
 	}
 }
 
@@ -352,45 +665,99 @@ void TB_Clear(int left, int top, int right, int bottom)
 
 void TB_Scroll()
 {
-	int i;
-	
-	i = tb_first_used;
-	while (i!=TB_NONE)
+	int i, k, r, next, moving = 0;
+	char moved = false;
+	int striptop = physical_windowtop, stripbottom = physical_windowtop+lineheight/2;
+	int scrolltop = physical_windowtop+lineheight, scrollbottom = physical_windowbottom;
+
+	/* Remove first the cells which will be scrolled away */
+	for (k=tb_active_count-1; k>=0; k--)
 	{
-		int next = tb_list[i].next;
+		if (k >= tb_active_count) continue;
+		r = tb_active_rows[k];
 
-		/* Remove first the cells which will be scrolled away */
-		if (TB_InBounds(i, physical_windowleft, physical_windowtop,
-			physical_windowright, physical_windowtop+lineheight/2))
+		switch (TB_RowInBounds(r, physical_windowleft, striptop,
+			physical_windowright, stripbottom))
 		{
-#ifdef TB_DEBUG
-			printf("TB_Scroll(): ");
-#endif
-			TB_Remove(i);
+			case TB_NO_CELLS:
+				continue;
+			case TB_ALL_CELLS:
+				for (i=tb_rows[r].first; i!=TB_NONE; i=next)
+				{
+					next = tb_list[i].rownext;
+					TB_Remove(i);
+				}
+				continue;
 		}
 
-		/* Then scroll up the remaining cells */
-		if (TB_InBounds(i, physical_windowleft, physical_windowtop+lineheight,
-			physical_windowright, physical_windowbottom))
+		for (i=tb_rows[r].first; i!=TB_NONE; i=next)
 		{
+			next = tb_list[i].rownext;
+			if (TB_InBounds(i, physical_windowleft, striptop,
+				physical_windowright, stripbottom))
+			{
 #ifdef TB_DEBUG
-//			printf("TB_Scroll(): scrolling tb_list[%d]: '%s'\n", i, tb_list[i].data);
+				printf("TB_Scroll(): ");
 #endif
-			tb_list[i].top -= lineheight;
-			tb_list[i].bottom -= lineheight;
-			
-			/* Don't scroll areas into the invalidation zone until the
-			   bottom is invalidated
-			*/
-			if ((tb_list[i].data) &&
-				!strcmp(tb_list[i].data, WINDOW_CELL) && tb_list[i].top<0 &&
-				tb_list[i].bottom > tb_list[i].top)
+				TB_Remove(i);
+			}
+		}
+	}
+
+	/* Then scroll up the remaining cells.  A row that scrolls as a
+	   whole just needs its top moved; cells that have to leave their
+	   row are moved afterwards, so that nothing gets scrolled twice.
+	*/
+	for (k=0; k<tb_active_count; k++)
+	{
+		r = tb_active_rows[k];
+
+		switch (TB_RowInBounds(r, physical_windowleft, scrolltop,
+			physical_windowright, scrollbottom))
+		{
+			case TB_NO_CELLS:
+				continue;
+			case TB_ALL_CELLS:
+				if (tb_rows[r].windows==0)
+				{
+					tb_rows[r].top -= lineheight;
+					moved = true;
+					continue;
+				}
+		}
+
+		for (i=tb_rows[r].first; i!=TB_NONE; i=tb_list[i].rownext)
+		{
+			if (TB_InBounds(i, physical_windowleft, scrolltop,
+				physical_windowright, scrollbottom))
 			{
-				tb_list[i].top = 0;
+				tb_moving[moving++] = i;
 			}
 		}
+	}
 
-		i = next;
+	/* Rows outside the window stayed put */
+	if (moved) TB_SortRows();
+
+	for (k=0; k<moving; k++)
+	{
+		int celltop, cellbottom;
+
+		i = tb_moving[k];
+		celltop = TB_TOP(i) - lineheight;
+		cellbottom = celltop + tb_list[i].height;
+
+		/* Don't scroll areas into the invalidation zone until the
+		   bottom is invalidated
+		*/
+		if (tb_list[i].window && celltop<0 && cellbottom > celltop)
+		{
+			celltop = 0;
+		}
+
+		TB_RemoveFromRow(i);
+		tb_list[i].height = cellbottom-celltop;
+		TB_AddToRow(i, celltop);
 	}
 }
 
@@ -403,89 +770,108 @@ void TB_Scroll()
 
 char *TB_FindWord(int x, int y)
 {
-	int i;
+	static char buf[255];
+	char instring = false;
+	int i, k, r, found = TB_NONE;
+	int n = 0, len;
+	char *w;
+	char c;
 	
 	tb_selected = TB_NONE;
 
 	if (!allow_text_selection) return NULL;
 
-	for (i=tb_last_used; i!=TB_NONE; i=tb_list[i].prev)
+	/* The most recently added word wins if there's an overlap.  Only
+	   rows starting at or above y, and no further up than the tallest
+	   row, can reach it.
+	*/
+	for (k=TB_RowPos(y+1)-1; k>=0; k--)
 	{
-		if (x >= tb_list[i].left && x <=tb_list[i].right &&
-			y >= tb_list[i].top && y <= tb_list[i].bottom)
+		r = tb_active_rows[k];
+		if (tb_rows[r].top < y-tb_max_height) break;
+		if (y > tb_rows[r].top+tb_rows[r].maxheight)
+			continue;
+
+		for (i=tb_rows[r].first; i!=TB_NONE; i=tb_list[i].rownext)
 		{
-			static char buf[255];
-			char instring = false;
-			int n = 0, len;
-			char *w = tb_list[i].data;
-			char c;
-			
-			if (!strcmp(w, WINDOW_CELL)) return NULL;
-			
-			tb_selected = i;
-
-			len = strlen(w);
-			for (i=0; i<len; i++)
+			if (x >= tb_list[i].left && x <=tb_list[i].right &&
+				y <= TB_BOTTOM(i) &&
+				(found==TB_NONE || tb_list[i].age > tb_list[found].age))
 			{
-				/* Start only on a useful word */
-				c = w[i];
-				if ((c>='0' && c<='9') || (unsigned char)c>='A')
-				{
-#ifdef USE_SMARTFORMATTING
-					if (smartformatting)
-					{
-						switch ((unsigned char)c)
-						{
-							case 145:
-							case 146:
-								c = '\'';
-								break;
-							case 147:
-							case 148:
-								c = '\"';
-								break;
-							case 151:
-								buf[n++] = '-';
-								c = '-';
-								break;
-						}
-					}
+				found = i;
+			}
+		}
+	}
+
+	if (found==TB_NONE)
+	{
+#ifdef TB_DEBUG
+		printf("TB_FindWord(%d, %d): no match\n", x, y);
 #endif
-					buf[n++] = c;
-					instring = true;
-				}
-				else if ((unsigned char)c>=' ' && instring)
+		return NULL;
+	}
+
+	w = TB_DATA(found);
+	
+	if (!strcmp(w, WINDOW_CELL)) return NULL;
+	
+	tb_selected = found;
+
+	len = strlen(w);
+	for (i=0; i<len; i++)
+	{
+		/* Start only on a useful word */
+		c = w[i];
+		if ((c>='0' && c<='9') || (unsigned char)c>='A')
+		{
+#ifdef USE_SMARTFORMATTING
+			if (smartformatting)
+			{
+				switch ((unsigned char)c)
 				{
-					buf[n++] = c;
+					case 145:
+					case 146:
+						c = '\'';
+						break;
+					case 147:
+					case 148:
+						c = '\"';
+						break;
+					case 151:
+						buf[n++] = '-';
+						c = '-';
+						break;
 				}
 			}
-			buf[n] = '\0';
-		
-			/* Strip off any trailing punctuation */
-			i = strlen(buf);
-			for (; i; i--)
-			{
-				if ((buf[i]>='0' && buf[i]<='9') || (unsigned char)buf[i]>='A')
-					break;
-				buf[i] = '\0';
-			}
-		
-			if (n==0)
-			{
-				tb_selected = TB_NONE;
-				return NULL;
-			}
-#ifdef TB_DEBUG
-			printf("TB_FindWord(%d, %d) = '%s'\n", x, y, w);
 #endif
-			return buf;
+			buf[n++] = c;
+			instring = true;
+		}
+		else if ((unsigned char)c>=' ' && instring)
+		{
+			buf[n++] = c;
 		}
 	}
+	buf[n] = '\0';
 
+	/* Strip off any trailing punctuation */
+	i = strlen(buf);
+	for (; i; i--)
+	{
+		if ((buf[i]>='0' && buf[i]<='9') || (unsigned char)buf[i]>='A')
+			break;
+		buf[i] = '\0';
+	}
+
+	if (n==0)
+	{
+		tb_selected = TB_NONE;
+		return NULL;
+	}
 #ifdef TB_DEBUG
-	printf("TB_FindWord(%d, %d): no match\n", x, y);
+	printf("TB_FindWord(%d, %d) = '%s'\n", x, y, w);
 #endif
-	return NULL;
+	return buf;
 }
 
 #endif	/* USE_TEXTBUFFER */
@@ -649,7 +649,7 @@ extern void PrintFatalError(char *a);
 #endif
 
 #if !defined (SETMEM)
-#define SETMEM(addr, n) (mem[addr] = n)
+#define SETMEM(addr, n) SetMem(addr, n)
 #endif
 
 #if !defined (GETMEMADDR)
@@ -668,6 +668,18 @@ extern void PrintFatalError(char *a);
 #define HUGO_FOPEN fopen
 #endif
 
+/* Used by FileIO() for "readfile"/"writefile" data files, which a port
+   may want to handle differently from other files.  <ok> is false if
+   the file is being closed after an error, so that anything written to
+   it can be dropped.
+*/
+#if !defined (HUGO_FOPEN_DATA)
+#define HUGO_FOPEN_DATA HUGO_FOPEN
+#endif
+#if !defined (HUGO_FCLOSE_DATA)
+#define HUGO_FCLOSE_DATA(file, ok) hugo_fclose(file)
+#endif
+
 #ifndef HUGO_INLINE
 #define NO_INLINE_MEM_FUNCTIONS
 #define HUGO_INLINE static
@@ -689,7 +701,9 @@ extern void srandom(int);
 #ifdef LOADGAMEDATA_REPLACED
 /* If LOADGAMEDATA_REPLACED is #defined, LoadGameData() is called by
    both LoadGame() and RunRestart().  RunRestart() sets the reload flag
-   to true.
+   to true.  A replacement RestoreGameData(), on the other hand, should
+   write to game memory with SETMEM(), so that anything derived from it
+   is updated (see MemGeneration()).
 */
 int LoadGameData(char reload);
 #endif
@@ -733,6 +747,17 @@ enum ERROR_TYPE                 /* fatal errors */
 	DIVIDE_E		/* divide by zero		*/
 };
 
+enum MEM_REGION                 /* see MemGeneration() */
+{
+	OBJECT_REGION,          /* object table                 */
+	PROPERTY_REGION,        /* property table               */
+	EVENT_REGION,           /* event table                  */
+	ARRAY_REGION,           /* array table                  */
+	DICT_REGION,            /* dictionary                   */
+	SYNONYM_REGION,         /* synonym table and beyond     */
+	MEM_REGIONS
+};
+
 /* The positions of various data in the header: */
 #define H_GAMEVERSION	0x00
 #define H_ID		0x01
@@ -911,6 +936,9 @@ int hugo_timewait(int n);
 #if defined (SCROLLBACK_DEFINED)
 void hugo_sendtoscrollback(char *a);
 #endif
+#if defined (TIMESLICE_DEFINED)
+int hugo_timeslice(long addr);
+#endif
 #if !defined (HUGO_FCLOSE)
 #define hugo_fclose fclose
 #endif
@@ -965,6 +993,7 @@ extern char inobj;
 
 /* hemisc.c */
 void AP(char *a);
+void APSpan(char *a, int alen, char sticky);
 int CallRoutine(unsigned int addr);
 void ContextCommand(void);
 unsigned int Dict(void);
@@ -976,6 +1005,7 @@ char *GetString(long addr);
 char *GetText(long textaddr);
 char *GetWord(unsigned int a);
 void HandleTailRecursion(long addr);
+int HasPrintable(char *a, int len);
 void InitGame(void);
 void LoadGame(void);
 void ParseCommandLine(int argc, char *argv[]);
@@ -986,12 +1016,17 @@ unsigned int PeekWord(long a);
 void Poke(unsigned int a, unsigned char v);
 void PokeWord(unsigned int a, unsigned int v);
 #endif
+unsigned long MemGeneration(int region);
+unsigned long ObjectGeneration(int obj);
 char *PrintHex(long a);
 void Printout(char *a, int no_scrollback_linebreak);
+void PrintRun(char *run, int len);
 /* void PrintSetting(int t, int a, int b, int c, int d); */
 void PromptMore(void);
 int RecordCommands(void);
 void SaveUndo(int t, int a, int b, int c, int d);
+void SaveUndoArray(unsigned int addr, int count);
+int UndoHasArrayData(void);
 void SetStackFrame(int depth, int type, long brk, long returnaddr);
 void SetupDisplay(void);
 char SpecialChar(char *a, int *i);
@@ -1039,6 +1074,8 @@ extern char context_command[][64];
 extern int context_commands;
 #endif
 extern unsigned char *mem;
+extern unsigned long mem_generation[];
+extern unsigned long *object_generation;
 extern int loaded_in_memory;
 extern unsigned int defseg;
 extern unsigned int gameseg;
@@ -1071,6 +1108,7 @@ extern char leftquote;
 #endif
 
 /* heobject.c */
+void BuildAttributeIndex(void);
 int Child(int obj);
 int Children(int obj);
 int Elder(int obj);
@@ -1079,6 +1117,7 @@ int GetProp(int obj, int p, int n, char s);
 int GrandParent(int obj);
 void MoveObj(int obj, int p);
 char *Name(int obj);
+int NextWithAttributes(int obj, int n, int *attr, char *nattr);
 int Parent(int obj);
 unsigned int PropAddr(int obj, int p, unsigned int offset);
 void PutAttributes(int obj, unsigned long a, int attribute_set);
@@ -1094,8 +1133,10 @@ extern int display_pointer_x, display_pointer_y;
 
 /* heparse.c */
 int Available(int obj, char non_grammar);
+int AvailableCached(int obj, int dom);
 void CallLibraryParse(void);
 void FindObjProp(int obj);
+int FindSynonym(unsigned int w, int from);
 unsigned int FindWord(char *a);
 void KillWord(int a);
 int MatchCommand(void);
@@ -1103,7 +1144,12 @@ int ObjWord(int obj, unsigned int w);
 int Parse(void);
 void ParseError(int e, int a);
 void RemoveWord(int a);
+void ResetAvailableCache(void);
 void SeparateWords(void);
+void SetupPunctuation(void);
+void SetupObjLists(void);
+void SetupSynonyms(void);
+int TimeValue(char *a);
 int ValidObj(int obj);
 
 extern char buffer[];
@@ -1136,6 +1182,7 @@ extern char addflag;
 extern int speaking;
 extern char oops[];
 extern int oopscount;
+extern char memoize_available;
 
 
 /* heres.c */
@@ -1167,6 +1214,7 @@ int RunScriptSet(void);
 void RunSet(int gotvalue);
 int RunString(void);
 int RunSystem(void);
+void RunTextData(long textaddr, char sticky);
 void RunWindow(void);
 
 extern char during_player_input;
@@ -1181,6 +1229,49 @@ extern long tail_recursion_addr;
 extern int last_window_top, last_window_bottom,
 	last_window_left, last_window_right;
 extern char just_left_window;
+#if defined (TIMESLICE_DEFINED)
+extern long timeslice_statements;
+extern long timeslice_count;
+#endif
+
+#if defined (NATIVE_ROUTINES)
+/* Routines translated ahead of time to C (see "hugor-cli --translate").
+   The table is sorted by address, and is only used if the serial number
+   and code size match those of the loaded game.
+*/
+struct NATIVE_ROUTINE
+{
+	long addr;
+	void (*run)(void);
+};
+
+void CheckNativeRoutines(void);
+int RunNativeRoutine(long addr);
+void ResumeRoutine(int depth);
+
+/* What RunRoutine() does before each statement, for the translated
+   routine at <addr>
+*/
+#if defined (TIMESLICE_DEFINED)
+#define NATIVE_STATEMENT(addr) \
+	defseg = gameseg; \
+	if (var[endflag]) return; \
+	if (timeslice_statements && ++timeslice_count >= timeslice_statements) \
+	{ \
+		timeslice_count = 0; \
+		if (hugo_timeslice(addr)) {var[endflag] = -1; return;} \
+	}
+#else
+#define NATIVE_STATEMENT(addr) \
+	defseg = gameseg; \
+	if (var[endflag]) return;
+#endif
+
+extern const struct NATIVE_ROUTINE native_routine_table[];
+extern const int native_routine_count;
+extern const char native_routine_serial[];
+extern const long native_routine_codeend;
+#endif
 
 
 /* heset.c */
@@ -1189,6 +1280,12 @@ extern char arrexpr;
 extern char multiprop;
 
 
+/* heverify.c */
+void VerifyGame(long filelength);
+
+extern char verify_code;
+
+
 /* stringfn.c */
 char *Left(char *a, int l);
 char *Ltrim(char *a);
@@ -1209,6 +1306,34 @@ extern unsigned char minimal_windowing, illegal_window;
 
 /*-------------------------------------------------------------------------*/
 
+/* Every write to game memory goes through here, so that caches of
+   anything derived from it can tell when it has changed (see
+   MemGeneration()).  The tables are in memory in this order.
+*/
+HUGO_INLINE void SetMem(long a, unsigned char v)
+{
+	if (a >= arraytable*16L)
+	{
+		if (a >= syntable*16L)
+			mem_generation[SYNONYM_REGION]++;
+		else if (a >= dicttable*16L)
+			mem_generation[DICT_REGION]++;
+		else
+			mem_generation[ARRAY_REGION]++;
+	}
+	else if (a >= eventtable*16L)
+		mem_generation[EVENT_REGION]++;
+	else if (a >= proptable*16L)
+		mem_generation[PROPERTY_REGION]++;
+	else if (a >= objtable*16L)
+	{
+		mem_generation[OBJECT_REGION]++;
+		if (object_generation && a >= objtable*16L+2 && (a-objtable*16L-2)/object_size < objects)
+			object_generation[(a-objtable*16L-2)/object_size]++;
+	}
+	mem[a] = v;
+}
+
 #ifndef NO_INLINE_MEM_FUNCTIONS
 
 HUGO_INLINE unsigned char Peek(long a)
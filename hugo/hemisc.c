@@ -12,11 +12,13 @@
 		Flushpbuffer            PromptMore
 		GetCommand              RecordCommands
 		GetString               SaveUndo
-		GetText                 SetStackFrame
+		GetText                 SaveUndoArray
+		                        SetStackFrame
 		GetWord                 SetupDisplay
 		HandleTailRecursion	SpecialChar
 		InitGame                TrytoOpen
 		LoadGame		Undo
+		                        UndoHasArrayData
 
 	for the Hugo Engine
 
@@ -91,6 +93,8 @@ int context_commands;
 
 /* Loaded memory image */
 unsigned char *mem = NULL;		/* the memory buffer       */
+unsigned long mem_generation[MEM_REGIONS];	/* writes per region  */
+unsigned long *object_generation = NULL;	/* writes per object  */
 int loaded_in_memory = true;		/* i.e., the text bank     */
 unsigned int defseg;			/* holds segment indicator */
 unsigned int gameseg;			/* code segment            */
@@ -133,6 +137,13 @@ int undoturn = 0;                       /* number of operations this turn  */
 char undoinvalid = 0;                   /* for start of game, and restarts */
 char undorecord = 0;                    /* true when recording             */
 
+/* Array data saved by SaveUndoArray(), used as a ring; the serial
+   number counts every word ever saved
+*/
+#define UNDO_ARRAYDATA_SIZE (MAXUNDO*16)
+static unsigned short undo_arraydata[UNDO_ARRAYDATA_SIZE];
+static unsigned int undo_arraydata_serial = 0;
+
 #ifdef USE_TEXTBUFFER
 static int bufferbreak = 0, bufferbreaklen = 0;
 #endif
@@ -140,12 +151,36 @@ static int bufferbreak = 0, bufferbreaklen = 0;
 /* AP
 
 	The all-purpose printing routine that takes care of word-wrapping.
+	A trailing "\;" in <a> overrides the newline.
 */
 
 void AP (char *a)
 {
-	char sticky = false, skipspchar = false, startofline = 0;
-	int i, alen, plen, cwidth;
+	int alen = (int)strlen(a);
+	char sticky = false;
+
+	/* Semi-colon overrides LF */
+	if (alen>=2 && a[alen-1]==';' && a[alen-2]=='\\')
+	{
+		sticky = true;
+		alen -= 2;
+	}
+
+	APSpan(a, alen, sticky);
+}
+
+
+/* APSPAN
+
+	Does the work for AP(), given the first <alen> characters of <a>
+	(without any trailing "\;") and whether or not the newline is
+	overridden.
+*/
+
+void APSpan(char *a, int alen, char sticky)
+{
+	char skipspchar = false, startofline = 0;
+	int i, plen, cwidth;
 	char c = 0;			/* current character */
 #ifdef USE_SMARTFORMATTING
 	char lastc = 0;			/* for smart formatting */
@@ -165,22 +200,17 @@ void AP (char *a)
 	/* Shameless little trick to override control characters in engine-
 	   printed text, such as MS-DOS filenames that contain '\'s:
 	*/
-	if (a[0]==NO_CONTROLCHAR)
+	if (alen && a[0]==NO_CONTROLCHAR)
 	{
 		skipspchar = true;
 		a++;
+		alen--;
 	}
 
-	/* Semi-colon overrides LF */
-	if ((strlen(a)>=2) && a[strlen(a)-1]==';' && a[strlen(a)-2]=='\\')
-	{
-		sticky = true;
-	}
-
-	if (hugo_strlen(pbuffer))
+	plen = strlen(pbuffer);
+	if (HasPrintable(pbuffer, plen))
 		printed_something = true;
 
-	plen = strlen(pbuffer);
 	if (plen==0)
 	{
 		thisline = 0;
@@ -198,7 +228,7 @@ void AP (char *a)
 	}
 
 	/* Check for color changes */
-	if ((a[0]) && (lastfcolor!=fcolor || lastbgcolor!=bgcolor || startofline))
+	if ((alen || sticky) && (lastfcolor!=fcolor || lastbgcolor!=bgcolor || startofline))
 	{
 		if (plen >= MAXBUFFER*2-3) FatalError(OVERFLOW_E);
 		pbuffer[plen++] = COLOR_CHANGE;
@@ -211,7 +241,7 @@ void AP (char *a)
 
 	/* Check for font changes--since fonts can only get changed
 	   by printing, we don't check lastfont */
-	if ((a[0]) && startofline)
+	if ((alen || sticky) && startofline)
 	{
 		if (plen >= MAXBUFFER*2-2) FatalError(OVERFLOW_E);
 		pbuffer[plen++] = FONT_CHANGE;
@@ -222,10 +252,6 @@ void AP (char *a)
 
 	/* Begin by looping through the entire provided string: */
 
-	alen = (int)strlen(a);
-	if (sticky)
-		alen -= 2;
-
 	/* Not printing any actual text, so we won't need to go through
 	   queued font changes
 	*/
@@ -318,7 +344,7 @@ AddFontCode:
 							}
 						}
 #ifdef USE_TEXTBUFFER
-						if (hugo_strlen(pbuffer+bufferbreak)==0)
+						if (!HasPrintable(pbuffer+bufferbreak, plen-bufferbreak))
 							bufferfont = currentfont;
 #endif
 						if (plen >= MAXBUFFER*2-2) FatalError(OVERFLOW_E);
@@ -407,7 +433,7 @@ AddFontCode:
 			bufferbreak = 0;
 			bufferbreaklen = 0;
 #endif
-			strcpy(pbuffer, "");
+			pbuffer[0] = '\0';
 			plen = 0;
 			linebreak = 0;
 			linebreaklen = 0;
@@ -495,7 +521,7 @@ AddFontCode:
 			hugo_font(currentfont = tempfont);
 
 			pbuffer[linebreak] = t;
-			plen = strlen(pbuffer+linebreak);
+			plen -= linebreak;
 			memmove(pbuffer, pbuffer+linebreak, plen + 1);
 			thisline = thisline - linebreaklen;
 			linebreak = 0;
@@ -552,7 +578,7 @@ AddFontCode:
 		hugo_font(currentfont = lastfont);
 		Printout(pbuffer, 0);
 		lastfont = currentfont;
-		strcpy(pbuffer, "");
+		pbuffer[0] = '\0';
 		linebreak = 0;
 		linebreaklen = 0;
 		thisline = 0;
@@ -935,7 +961,7 @@ void FileIO(void)
 	{
 #if !defined (GLK)
 		/* stdio implementation */
-		if ((io = HUGO_FOPEN(fileiopath, "wb"))==NULL) goto LeaveFileIO;
+		if ((io = HUGO_FOPEN_DATA(fileiopath, "wb"))==NULL) goto LeaveFileIO;
 #else
 		/* Glk implementation */
 		frefid_t fref = NULL;
@@ -952,7 +978,7 @@ void FileIO(void)
 	{
 #if !defined (GLK)
 		/* stdio implementation */
-		if ((io = HUGO_FOPEN(fileiopath, "rb"))==NULL) goto LeaveFileIO;
+		if ((io = HUGO_FOPEN_DATA(fileiopath, "rb"))==NULL) goto LeaveFileIO;
 #else
 		/* Glk implementation */
 		frefid_t fref = NULL;
@@ -982,7 +1008,7 @@ void FileIO(void)
 
 	if (ioerror) retflag = 0;
 
-	hugo_fclose(io);
+	HUGO_FCLOSE_DATA(io, !ioerror);
 	io = NULL;
 	ioblock = 0;
 
@@ -996,6 +1022,8 @@ LeaveFileIO:
 
 void Flushpbuffer()
 {
+	int plen;
+
 	if (pbuffer[0]=='\0') return;
 
 #ifdef USE_TEXTBUFFER
@@ -1012,8 +1040,9 @@ void Flushpbuffer()
 	}
 #endif
 
-	pbuffer[strlen(pbuffer)+1] = '\0';
-	pbuffer[strlen(pbuffer)] = (char)NO_NEWLINE;
+	plen = strlen(pbuffer);
+	pbuffer[plen+1] = '\0';
+	pbuffer[plen] = (char)NO_NEWLINE;
 	Printout(Ltrim(pbuffer), 0);
 	currentpos = hugo_textwidth(pbuffer);	/* -charwidth; */
 	strcpy(pbuffer, "");
@@ -1224,6 +1253,31 @@ void HandleTailRecursion(long addr)
 }
 
 
+/* HASPRINTABLE
+
+	Returns true if the first <len> characters of <a> contain anything
+	other than color and font change codes, i.e., if hugo_strlen()
+	would be non-zero, but without needing <a> to be terminated or
+	counting past the first printable character.
+*/
+
+int HasPrintable(char *a, int len)
+{
+	int i;
+
+	for (i=0; i<len; i++)
+	{
+		if (a[i]==COLOR_CHANGE)
+			i+=2;
+		else if (a[i]==FONT_CHANGE)
+			i++;
+		else
+			return true;
+	}
+	return false;
+}
+
+
 /* INITGAME */
 
 void InitGame(void)
@@ -1242,6 +1296,9 @@ void InitGame(void)
 	
 	SetStackFrame(stack_depth, RUNROUTINE_BLOCK, 0, 0);
 
+	/* For SeparateWords() */
+	SetupPunctuation();
+
 	/* Figure out which objects have either a noun or an adjective property;
 	   store it in obj_parselist, one bit per object */
 	if ((!obj_parselist) && (obj_parselist = (char *)hugo_blockalloc(sizeof(char)*((objects+7)/8))))
@@ -1470,6 +1527,16 @@ void LoadGame(void)
 	defseg = syntable;
 	syncount = PeekWord(0);
 
+	/* Write counters (see SetMem()) */
+	if (object_generation) hugo_blockfree(object_generation);
+	if ((object_generation = (unsigned long *)hugo_blockalloc(sizeof(unsigned long)*objects))!=NULL)
+		memset(object_generation, 0, sizeof(unsigned long)*objects);
+
+	BuildAttributeIndex();
+
+	/* Check the code before anything gets to run */
+	if (verify_code) VerifyGame(filelength);
+
 
 	/* Additional information to be found: */
 
@@ -1502,6 +1569,13 @@ void LoadGame(void)
 		}
 		synptr+=5;
 	}
+
+	SetupSynonyms();
+	SetupObjLists();
+
+#if defined (NATIVE_ROUTINES)
+	CheckNativeRoutines();
+#endif
 }
 
 
@@ -1650,6 +1724,35 @@ void PokeWord(unsigned int a, unsigned int v)
 #endif	/* NO_INLINED_MEM_FUNCTIONS */
 
 
+/* MEMGENERATION
+
+	Returns the number of writes to the given region of game memory
+	(OBJECT_REGION, PROPERTY_REGION, etc.) so far.  Anything derived
+	from that region is still valid as long as this hasn't changed.
+*/
+
+unsigned long MemGeneration(int region)
+{
+	if (region<0 || region>=MEM_REGIONS) return 0;
+
+	return mem_generation[region];
+}
+
+
+/* OBJECTGENERATION
+
+	The same as MemGeneration(), but only for writes to the object
+	table entry (parent, sibling, child, attributes, etc.) of <obj>.
+*/
+
+unsigned long ObjectGeneration(int obj)
+{
+	if (object_generation==NULL || obj<0 || obj>=objects) return 0;
+
+	return object_generation[obj];
+}
+
+
 /* PRINTHEX
 
 	Returns <a> as a hex-number string in XXXXXX format.
@@ -1676,6 +1779,28 @@ char *PrintHex(long a)
 }
 
 
+/* PRINTRUN
+
+	Called by Printout() to pass <len> characters of <run> that share
+	the same font and color to the port in a single hugo_print().
+*/
+
+void PrintRun(char *run, int len)
+{
+	/* A minor adjustment for font changes and RunWindow() to make
+	   sure we're not printing unnecessarily downscreen
+	*/
+	if ((just_left_window) && current_text_y > physical_windowbottom-lineheight)
+	{
+		current_text_y = physical_windowbottom-lineheight;
+	}
+	just_left_window = false;
+
+	run[len] = '\0';
+	hugo_print(run);
+}
+
+
 /* PRINTOUT
 
 	Print to client display taking into account cursor relocation, 
@@ -1684,12 +1809,23 @@ char *PrintHex(long a)
 
 void Printout(char *a, int no_scrollback_linebreak)
 {
-	char b[2], sticky = 0, trimmed = 0;
+	char b, sticky = 0, trimmed = 0;
 	char tempfcolor;
-	int i, l;
+	int i, l, alen;
 	int n;
 	int last_printed_font = currentfont;
 
+	/* Runs of characters printed in the same font and color are
+	   collected here and passed to the port all at once
+	*/
+	static char run[MAXBUFFER*2+1];
+	static char scriptrun[MAXBUFFER*2+1];
+	int runlen = 0, scriptlen = 0;
+#if defined (SCROLLBACK_DEFINED)
+	static char scrollbackrun[MAXBUFFER*4+1];	/* "--" for 151 */
+	int scrollbacklen = 0;
+#endif
+
 	/* hugo_font() should do this if necessary, but just in case */
 	if (lineheight < FIXEDLINEHEIGHT)
 		lineheight = FIXEDLINEHEIGHT;
@@ -1704,14 +1840,16 @@ void Printout(char *a, int no_scrollback_linebreak)
 			PromptMore();
 	}
 
-	if ((a[0]!='\0') && a[strlen(a)-1]==(char)NO_NEWLINE)
+	/* Everything printed comes from pbuffer, so it fits in run[] */
+	alen = strlen(a);
+	if (alen > MAXBUFFER*2) FatalError(OVERFLOW_E);
+
+	if (alen && a[alen-1]==(char)NO_NEWLINE)
 	{
-		a[strlen(a)-1] = '\0';
+		a[--alen] = '\0';
 		sticky = true;
 	}
 
-	b[0] = b[1] = '\0';
-
 
 	/* The easy part is just skimming <a> and processing each code
 	   or printed character, as the case may be:
@@ -1719,7 +1857,7 @@ void Printout(char *a, int no_scrollback_linebreak)
 	
 	l = 0;	/* physical length of string */
 
-	for (i=0; i<(int)strlen(a); i++)
+	for (i=0; i<alen; i++)
 	{
 		if ((a[i]==' ') && !trimmed && currentpos==0)
 		{
@@ -1732,7 +1870,14 @@ void Printout(char *a, int no_scrollback_linebreak)
 			last_printed_font = currentfont;
 		}
 
-		switch (b[0] = a[i])
+		/* Anything pending was printed in the old font or color */
+		if ((a[i]==FONT_CHANGE || a[i]==COLOR_CHANGE) && runlen)
+		{
+			PrintRun(run, runlen);
+			runlen = 0;
+		}
+
+		switch (b = a[i])
 		{
 			case FONT_CHANGE:
 				n = (int)(a[++i]-1);
@@ -1748,48 +1893,56 @@ void Printout(char *a, int no_scrollback_linebreak)
 				break;
 
 			default:
-				if (b[0]==FORCED_SPACE) b[0] = ' ';
-				l += hugo_charwidth(b[0]);
-
-				/* A minor adjustment for font changes and RunWindow() to make
-				   sure we're not printing unnecessarily downscreen
-				*/
-				if ((just_left_window) && current_text_y > physical_windowbottom-lineheight)
-				{
-					current_text_y = physical_windowbottom-lineheight;
-				}
-				just_left_window = false;
-
-				hugo_print(b);
+				if (b==FORCED_SPACE) b = ' ';
+				l += hugo_charwidth(b);
+				run[runlen++] = b;
 		}
 
-		if (script && (unsigned char)b[0]>=' ')
-			if (hugo_writetoscript(b) < 0) FatalError(WRITE_E);
+		if (script && (unsigned char)b>=' ')
+			scriptrun[scriptlen++] = b;
 
 #if defined (SCROLLBACK_DEFINED)
-		if (!inwindow && (unsigned char)b[0]>=' ')
+		if (!inwindow && (unsigned char)b>=' ')
 		{
 #ifdef USE_SMARTFORMATTING
 			/* Undo smart-formatting for ASCII scrollback */
-			switch ((unsigned char)b[0])
+			switch ((unsigned char)b)
 			{
 				case 151:
-					hugo_sendtoscrollback("--");
-					continue;
+					scrollbackrun[scrollbacklen++] = '-';
+					b = '-';
+					break;
 				case 145:
 				case 146:
-					b[0] = '\'';
+					b = '\'';
 					break;
 				case 147:
 				case 148:
-					b[0] = '\"';
+					b = '\"';
 			}
 #endif
-			hugo_sendtoscrollback(b);
+			scrollbackrun[scrollbacklen++] = b;
 		}
 #endif
 	}
 
+	if (runlen)
+		PrintRun(run, runlen);
+
+	if (scriptlen)
+	{
+		scriptrun[scriptlen] = '\0';
+		if (hugo_writetoscript(scriptrun) < 0) FatalError(WRITE_E);
+	}
+
+#if defined (SCROLLBACK_DEFINED)
+	if (scrollbacklen)
+	{
+		scrollbackrun[scrollbacklen] = '\0';
+		hugo_sendtoscrollback(scrollbackrun);
+	}
+#endif
+
 	/* If we've got a linefeed and didn't hit the right edge of the
 	   window
 	*/
@@ -2102,6 +2255,7 @@ int RecordCommands(void)
 	attribute:      (ATTR_T, obj., attr., 0 or 1, 0)
 	variable:       (VAR_T, var., value, 0, 0)
 	array:          (ARRAYDATA_T, array addr., element, val., 0)
+	array range:    (ARRAY_T, addr., count, serial no., 0)
 	dict:           (DICT_T, entry length, 0, 0, 0)
 	word setting:   (WORD_T, word number, new word, 0, 0)
 */
@@ -2110,6 +2264,9 @@ void SaveUndo(int a, int b, int c, int d, int e)
 {
 	int tempptr;
 
+	/* Everything that changes the game state comes through here */
+	ResetAvailableCache();
+
 	if (undorecord)
 	{
 		undostack[undoptr][0] = a;      /* save the operation */
@@ -2136,6 +2293,68 @@ void SaveUndo(int a, int b, int c, int d, int e)
 }
 
 
+/* SAVEUNDOARRAY
+
+	Saves <count> words of the array table starting at <addr> as a
+	single undo operation, for changes to whole ranges of an array.
+	The old values go into undo_arraydata[]; the record only keeps
+	their serial number.
+*/
+
+void SaveUndoArray(unsigned int addr, int count)
+{
+	int i;
+	unsigned int tempseg;
+
+	if (!undorecord || count<=0)
+	{
+		ResetAvailableCache();
+		return;
+	}
+
+	/* Too much to save:  same as a turn that's too complex */
+	if (count > UNDO_ARRAYDATA_SIZE)
+	{
+		ResetAvailableCache();
+		undoptr = 0;
+		undoturn = MAXUNDO;
+		undoinvalid = 1;
+		return;
+	}
+
+	tempseg = defseg;
+	defseg = arraytable;
+	for (i=0; i<count; i++)
+	{
+		undo_arraydata[(undo_arraydata_serial+i)%UNDO_ARRAYDATA_SIZE] =
+			(unsigned short)PeekWord(addr+i*2);
+	}
+	defseg = tempseg;
+
+	SaveUndo(ARRAY_T, (int)addr, count, (int)undo_arraydata_serial, 0);
+	undo_arraydata_serial += count;
+}
+
+
+/* UNDOHASARRAYDATA
+
+	Returns true if the undo stack has any array range records.
+	Their data is only kept in undo_arraydata[], which isn't saved
+	with the game, so they can't be undone after a restore.
+*/
+
+int UndoHasArrayData(void)
+{
+	int i;
+
+	for (i=0; i<MAXUNDO; i++)
+	{
+		if (undostack[i][0]==ARRAY_T) return true;
+	}
+	return false;
+}
+
+
 /* SETSTACKFRAME
 
         Properly sets up the code_block structure for the current stack
@@ -2486,7 +2705,9 @@ int Undo()
 	int count = 0, n;
 	int turns, turncount, tempptr;
 	int obj, prop, attr, v;
-	unsigned int addr;
+	unsigned int addr, serial;
+
+	ResetAvailableCache();
 
 	if (--undoptr < 0) undoptr = MAXUNDO-1;
 
@@ -2515,6 +2736,15 @@ int Undo()
 			/* if end of turn */
 			if (undostack[undoptr][0]==0)
 				break;
+
+			/* Array data that has since been overwritten by
+			   newer SaveUndoArray() calls can't be restored
+			*/
+			if (undostack[undoptr][0]==ARRAY_T &&
+				undo_arraydata_serial-(unsigned int)undostack[undoptr][3] > UNDO_ARRAYDATA_SIZE)
+			{
+				goto CheckUndoFailed;
+			}
 		}
 		while (true);
 
@@ -2601,6 +2831,24 @@ int Undo()
 					break;
 				}
 
+				case ARRAY_T:
+				{
+					defseg = arraytable;
+					addr = undostack[undoptr][1];
+					n = undostack[undoptr][2];
+					serial = (unsigned int)undostack[undoptr][3];
+
+					for (v=0; v<n; v++)
+						PokeWord(addr+v*2, undo_arraydata[(serial+v)%UNDO_ARRAYDATA_SIZE]);
+
+					/* Newer data was undone first, so this
+					   space is free again
+					*/
+					undo_arraydata_serial = serial;
+					count++;
+					break;
+				}
+
 				case DICT_T:
 				{
 					defseg = dicttable;
@@ -3,16 +3,15 @@
 
 	Object/property/attribute management functions:
 
-		Child                   PutAttributes
-		Children                SetAttribute
-		Elder                   Sibling
-		GetAttributes           TestAttribute
-		GetProp                 Youngest
-		GrandParent
-		MoveObj
+		BuildAttributeIndex     NextWithAttributes
+		Child                   Parent
+		Children                PropAddr
+		Elder                   PutAttributes
+		GetAttributes           SetAttribute
+		GetProp                 Sibling
+		GrandParent             TestAttribute
+		MoveObj                 Youngest
 		Name
-		Parent
-		PropAddr
 
 	for the Hugo Engine
 
@@ -30,6 +29,23 @@ int display_object = -1;		/* i.e., non-existent (yet) */
 char display_needs_repaint = 0;		/* for display object       */
 int display_pointer_x = 0, display_pointer_y = 0;
 
+/* One bit per object for every attribute, so that objects with a
+   given set of attributes can be found a word at a time instead of
+   testing them one by one (see NextWithAttributes()).  It is brought
+   up to date from the object table whenever that has been written
+   to since (see SyncAttributeIndex()).
+*/
+static unsigned long *attr_index = NULL;
+static int attr_index_words = 0;	/* per attribute, 32 bits each */
+static unsigned long *attr_index_gen = NULL;	/* ObjectGeneration() */
+static unsigned long attr_index_objgen;		/* MemGeneration()    */
+
+static void IndexAttributes(int obj);
+static void SyncAttributeIndex(void);
+
+#define ATTR_INDEX_WORD(attr, w) attr_index[(attr)*attr_index_words + (w)]
+#define ATTR_INDEX_BIT(obj) (1UL<<((obj)%32))
+
 
 /* CHECKOBJECTRANGE
 
@@ -50,6 +66,98 @@ int CheckObjectRange(int obj)
 #endif
 
 
+/* BUILDATTRIBUTEINDEX
+
+	(Re)builds the attribute index from the object table.  Called
+	once the game is loaded (see LoadGame()); after that, every
+	write to the object table is caught by SyncAttributeIndex().
+*/
+
+void BuildAttributeIndex(void)
+{
+	int obj, words;
+
+	words = (objects+31)/32;
+	if (attr_index && words!=attr_index_words)
+	{
+		hugo_blockfree(attr_index);
+		hugo_blockfree(attr_index_gen);
+		attr_index = NULL;
+		attr_index_gen = NULL;
+	}
+	attr_index_words = words;
+	if (objects<=0) return;
+
+	/* Without the index, everything falls back to the object table */
+	if (attr_index==NULL)
+	{
+		attr_index = (unsigned long *)hugo_blockalloc(sizeof(unsigned long)*MAXATTRIBUTES*words);
+		attr_index_gen = (unsigned long *)hugo_blockalloc(sizeof(unsigned long)*objects);
+		if (attr_index==NULL || attr_index_gen==NULL)
+		{
+			if (attr_index) hugo_blockfree(attr_index);
+			if (attr_index_gen) hugo_blockfree(attr_index_gen);
+			attr_index = NULL;
+			attr_index_gen = NULL;
+			return;
+		}
+	}
+	memset(attr_index, 0, sizeof(unsigned long)*MAXATTRIBUTES*words);
+
+	for (obj=0; obj<objects; obj++)
+		IndexAttributes(obj);
+	attr_index_objgen = MemGeneration(OBJECT_REGION);
+}
+
+
+/* INDEXATTRIBUTES
+
+	Copies the attributes of <obj> from the object table into the
+	attribute index.
+*/
+
+static void IndexAttributes(int obj)
+{
+	int set, b;
+	unsigned long a;
+
+	for (set=0; set<MAXATTRIBUTES/32; set++)
+	{
+		a = GetAttributes(obj, set);
+		for (b=0; b<32; b++, a>>=1)
+		{
+			if (a & 1)
+				ATTR_INDEX_WORD(set*32+b, obj/32) |= ATTR_INDEX_BIT(obj);
+			else
+				ATTR_INDEX_WORD(set*32+b, obj/32) &= ~ATTR_INDEX_BIT(obj);
+		}
+	}
+	attr_index_gen[obj] = ObjectGeneration(obj);
+}
+
+
+/* SYNCATTRIBUTEINDEX
+
+	Re-indexes every object whose object table entry has been
+	written to since it was last indexed--whether by SetAttribute(),
+	undo, restart, restore, or anything else.
+*/
+
+static void SyncAttributeIndex(void)
+{
+	int obj;
+
+	if (attr_index_objgen==MemGeneration(OBJECT_REGION)) return;
+
+	for (obj=0; obj<objects; obj++)
+	{
+		if (attr_index_gen[obj]!=ObjectGeneration(obj))
+			IndexAttributes(obj);
+	}
+	attr_index_objgen = MemGeneration(OBJECT_REGION);
+}
+
+
 /* CHILD */
 
 int Child(int obj)
@@ -512,6 +620,8 @@ void MoveObj(int obj, int p)
 	if (obj==p) return;
 	if (obj<0 || obj>=objects) return;
 
+	ResetAvailableCache();
+
 	oldparent = Parent(obj);
 	/* if (oldparent==p) return; */
 
@@ -649,6 +759,69 @@ unsigned int PropAddr(int obj, int p, unsigned int offset)
 }
 
 
+/* NEXTWITHATTRIBUTES
+
+	Returns the first object after <obj> that has all of the <n>
+	attributes in <attr>, or, where <nattr> is true, doesn't have
+	them.  Returns 0 if there is none.
+*/
+
+int NextWithAttributes(int obj, int n, int *attr, char *nattr)
+{
+	int i, w;
+	unsigned long bits;
+
+	if (++obj < 1) obj = 1;
+	if (obj >= objects) return 0;
+
+	for (i=0; i<n; i++)
+	{
+		if (attr[i]<0 || attr[i]>=MAXATTRIBUTES) return 0;
+	}
+
+	if (attr_index==NULL)
+	{
+		for (; obj<objects; obj++)
+		{
+			for (i=0; i<n; i++)
+			{
+				if (!TestAttribute(obj, attr[i], nattr[i])) break;
+			}
+			if (i==n) return obj;
+		}
+		return 0;
+	}
+
+	SyncAttributeIndex();
+
+	for (w=obj/32; w<attr_index_words; w++)
+	{
+		bits = 0xFFFFFFFFUL;
+		if (w==obj/32) bits &= 0xFFFFFFFFUL<<(obj%32);
+
+		for (i=0; i<n && bits; i++)
+		{
+			if (nattr[i])
+				bits &= ~ATTR_INDEX_WORD(attr[i], w);
+			else
+				bits &= ATTR_INDEX_WORD(attr[i], w);
+		}
+
+		if (bits)
+		{
+			for (i=0; !(bits & 1); i++, bits>>=1);
+			obj = w*32 + i;
+
+			/* Bits past the last object are only set for
+			   attributes an object must not have
+			*/
+			return (obj < objects)?obj:0;
+		}
+	}
+	return 0;
+}
+
+
 /* PUTATTRIBUTES
 
 	Writes (puts) one of four sets of 32 attributes.
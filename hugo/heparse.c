@@ -5,6 +5,7 @@
 
 		Available
 		CallLibraryParse
+		FindSynonym
 		FindWord
 		KillWord
 		Match routines
@@ -26,6 +27,8 @@
 		RemoveWord
 		ResetFindObject
 		SeparateWords
+		SetupObjLists
+		SetupSynonyms
 
 	for the Hugo Engine
 
@@ -97,6 +100,39 @@ char parse_called_twice;
 char reparse_everything;
 char punc_string[64];                   /* punctuation string */
 
+/* Character classes for SeparateWords() */
+#define CC_LETTER	0
+#define CC_SPACE	1		/* ' ', '!', '?' */
+#define CC_PUNCTUATION	2		/* from punc_string */
+#define CC_QUOTE	3
+#define CC_STOP		4		/* '.' and ',' */
+static unsigned char char_class[256];
+
+/* Synonym table index, built by SetupSynonyms():  syn_head[] is a hash
+   table of dictionary entries, and syn_next[] chains the records (by
+   number, starting at 1) sharing a hash bucket, in table order.  It is
+   rebuilt if the synonym table is ever written to.
+*/
+static int *syn_head = NULL;
+static int *syn_next = NULL;
+static unsigned int syn_hashmask;
+static unsigned long syn_generation;	/* see MemGeneration() */
+
+/* Position of each object in objlist[] and pobjlist[], built by
+   SetupObjLists(), so that the lists don't have to be searched.  A
+   position only counts if the list really has the object there, so
+   a list can still be emptied by setting its count to 0.
+*/
+static unsigned char *objlist_pos = NULL;
+static unsigned char *pobjlist_pos = NULL;
+static int objlist_pos_size = 0;
+
+#define OBJ_INDEXED(obj) (objlist_pos && (obj)>=0 && (obj)<objlist_pos_size)
+
+static int ObjListPos(int obj);
+static int PossibleObjPos(int obj);
+static void IndexObjLists(void);
+
 char full_buffer = false;
 static char recursive_call = false;     /* to MatchObject() */
 
@@ -105,6 +141,19 @@ static char recursive_call = false;     /* to MatchObject() */
 */
 int parse_location;	/* usually var[location] */
 
+/* Memoized Available() results (see AvailableCached()) */
+char memoize_available = false;		/* set by the port to enable */
+struct available_cache_structure
+{
+	unsigned int gen;		/* valid if equal to available_gen */
+	int domain;			/* FindObject()'s second argument  */
+	int result;
+};
+static struct available_cache_structure *available_cache = NULL;
+static unsigned int available_gen = 1;
+#define AVAILABLE_CONTEXT 9
+static int available_context[AVAILABLE_CONTEXT];
+
 
 /* ADDALLOBJECTS
 */
@@ -139,16 +188,11 @@ void AddAllObjects(int loc)
 
 void AddObj(int obj)
 {
-	int i;
-
-	for (i=0; i<objcount; i++)
-	{
-		if (objlist[i]==obj)
-			return;
-	}
+	if (ObjListPos(obj)!=-1 || objcount==MAXOBJLIST)
+		return;
 
-	objlist[(int)objcount] = obj;
-	if (++objcount> MAXOBJLIST) objcount = MAXOBJLIST;
+	if (OBJ_INDEXED(obj)) objlist_pos[obj] = (unsigned char)objcount;
+	objlist[(int)objcount++] = obj;
 }
 
 
@@ -165,19 +209,16 @@ void AddPossibleObject(int obj, char type, unsigned int w)
 	if (pobjcount==MAXPOBJECTS)
 		return;
 
-	for (i=0; i<pobjcount; i++)
+	/* If it is already in the list */
+	if ((i = PossibleObjPos(obj))!=-1)
 	{
-		/* If it is already in the list */
-		if (pobjlist[i].obj==obj)
-		{
-			/* Being referred to with a noun outweighs being
-			   referred to previously with an adjective
-			*/
-			if (type==(char)noun || ObjWordType(obj, w, noun))
-				pobjlist[i].type = (char)noun;
+		/* Being referred to with a noun outweighs being
+		   referred to previously with an adjective
+		*/
+		if (type==(char)noun || ObjWordType(obj, w, noun))
+			pobjlist[i].type = (char)noun;
 
-			return;
-		}
+		return;
 	}
 
 	/* Getting this to point is presuming that we're adding an object
@@ -186,6 +227,7 @@ void AddPossibleObject(int obj, char type, unsigned int w)
 	*/
 	if (ObjWordType(obj, w, noun)) type = (char)noun;
 	
+	if (OBJ_INDEXED(obj)) pobjlist_pos[obj] = (unsigned char)pobjcount;
 	pobjlist[pobjcount].obj = obj;
 	pobjlist[pobjcount].type = type;
 
@@ -281,7 +323,8 @@ int AnyObjWord(int wn)
 
 int Available(int obj, char non_grammar)
 {
-	int temp_stack_depth;
+	int temp_stack_depth, dom;
+	unsigned int gen;
 
 	if (findobjectaddr)
 	{
@@ -309,6 +352,14 @@ int Available(int obj, char non_grammar)
 				passlocal[1] = parse_location;
 		}
 
+		dom = passlocal[1];
+		if (memoize_available && AvailableCached(obj, dom))
+		{
+			passlocal[0] = passlocal[1] = 0;
+			return ret;
+		}
+		gen = available_gen;
+
 		ret = 0;
 
 		PassLocals(2);
@@ -323,6 +374,16 @@ int Available(int obj, char non_grammar)
 #endif
 		retflag = 0;
 		stack_depth = temp_stack_depth;
+
+		/* Only remember the result if FindObject didn't change
+		   anything itself
+		*/
+		if (memoize_available && gen==available_gen && obj>=0 && obj<objects)
+		{
+			available_cache[obj].gen = gen;
+			available_cache[obj].domain = dom;
+			available_cache[obj].result = ret;
+		}
 		return ret;
 	}
 	else
@@ -330,6 +391,59 @@ int Available(int obj, char non_grammar)
 }
 
 
+/* AVAILABLECACHED
+
+	Returns true (with the result in ret) if FindObject has already
+	been called for <obj> in <dom> since the last time anything
+	changed.  Any change that goes through SaveUndo() drops the
+	cache, as does a change to the globals the parser sets itself.
+*/
+
+int AvailableCached(int obj, int dom)
+{
+	int i, context[AVAILABLE_CONTEXT];
+
+	if (obj<0 || obj>=objects) return false;
+
+	if (available_cache==NULL)
+	{
+		if ((available_cache = (struct available_cache_structure *)hugo_blockalloc(sizeof(struct available_cache_structure)*objects))==NULL)
+		{
+			memoize_available = false;
+			return false;
+		}
+		for (i=0; i<objects; i++)
+			available_cache[i].gen = 0;
+	}
+
+	context[0] = parse_location;
+	context[1] = speaking;
+	context[2] = var[player];
+	context[3] = var[location];
+	context[4] = var[actor];
+	context[5] = var[verbroutine];
+	context[6] = var[object];
+	context[7] = var[xobject];
+	context[8] = var[self];
+	for (i=0; i<AVAILABLE_CONTEXT; i++)
+	{
+		if (context[i]!=available_context[i])
+		{
+			ResetAvailableCache();
+			for (i=0; i<AVAILABLE_CONTEXT; i++)
+				available_context[i] = context[i];
+			return false;
+		}
+	}
+
+	if (available_cache[obj].gen!=available_gen || available_cache[obj].domain!=dom)
+		return false;
+
+	ret = available_cache[obj].result;
+	return true;
+}
+
+
 /* CALLLIBRARYPARSE */
 
 void CallLibraryParse(void)
@@ -417,6 +531,51 @@ int DomainObj(int obj)
 }
 
 
+/* FINDSYNONYM
+
+	Returns the number of the first synonym table record from
+	<from> on (starting at 1) for dictionary entry <w>, or 0 if
+	there isn't one.
+*/
+
+#define SYN_HASH(w) (((w)*40503U)>>4)
+
+int FindSynonym(unsigned int w, int from)
+{
+	int j;
+
+	if (syn_head && syn_generation!=MemGeneration(SYNONYM_REGION))
+		SetupSynonyms();
+
+	/* Without an index, just go through the table */
+	if (syn_head==NULL)
+	{
+		defseg = syntable;
+		for (j=from; j<=syncount; j++)
+		{
+			if (PeekWord(2 + (j-1)*5 + 1)==w)
+				return j;
+		}
+		return 0;
+	}
+
+	defseg = syntable;
+
+	/* Carry on from the last match, if that's where we left off */
+	if (from > 1 && PeekWord(2 + (from-2)*5 + 1)==w)
+		j = syn_next[from-1];
+	else
+		j = syn_head[SYN_HASH(w) & syn_hashmask];
+
+	for (; j; j=syn_next[j])
+	{
+		if (j >= from && PeekWord(2 + (j-1)*5 + 1)==w)
+			return j;
+	}
+	return 0;
+}
+
+
 /* FINDWORD
 
 	Returns the dictionary address of <a>.
@@ -493,14 +652,7 @@ unsigned int FindWord(char *a)
 
 int InList(int obj)
 {
-	int i;
-
-	for (i=0; i<objcount; i++)
-	{
-		if (objlist[i]==obj)
-			return true;
-	}
-	return false;
+	return ObjListPos(obj)!=-1;
 }
 
 
@@ -1653,6 +1805,7 @@ RestoreTempArrays:
 			for (i=0; i<temppobjcount; i++)
 				pobjlist[i] = temppobjlist[i];
 			pobjcount = temppobjcount;
+			IndexObjLists();
 
 			/* Multiple disambig. results for a non-multi verb? */
 			i = Peek(grammaraddr);
@@ -1667,13 +1820,7 @@ RestoreTempArrays:
 			/* Check objlist against original pobjlist */
 			for (i=0; i<objcount; i++)
 			{
-				flag = 0;
-				for (j=0; j<pobjcount; j++)
-				{
-					if (pobjlist[j].obj==objlist[i])
-						flag = true;
-				}
-				if (!flag)
+				if (PossibleObjPos(objlist[i])==-1)
 				{
 					/* "You'll have to be more specific..." */
 					ParseError(13, 0);
@@ -1685,13 +1832,7 @@ RestoreTempArrays:
 			/* Check pobjlist against disambiguation objlist */
 			for (i=0; i<pobjcount; i++)
 			{
-				flag = 0;
-				for (j=0; j<objcount; j++)
-				{
-					if (pobjlist[i].obj==objlist[j])
-						flag = true;
-				}
-				if (!flag)
+				if (!InList(pobjlist[i].obj))
 				{
 					SubtractPossibleObject(pobjlist[i].obj);
 					i--;
@@ -1702,6 +1843,7 @@ RestoreTempArrays:
 				objlist[i] = tempobjlist[i];
 			objcount = (char)tempobjcount;
 			addflag = (char)tempaddflag;
+			IndexObjLists();
 
 			if (word[*wordnum][0]=='~') (*wordnum)--;
 		}
@@ -2204,6 +2346,9 @@ int Parse()
 	unsigned int period, comma;
 	unsigned int synptr;
 
+	/* Anything may have changed since the last command */
+	ResetAvailableCache();
+
 	period = FindWord(".");
 	comma = FindWord(",");
 
@@ -2280,62 +2425,59 @@ NotinDictionary:
 
 	for (i=1; i<=words; i++)                /* Look through words... */
 	{
-		synptr = 2;
-
-		for (j=1; j<=syncount; j++)  /* ...and alterations */
+		/* ...and alterations.  Note that <i> may change along the
+		   way, in which case the rest of the table is checked
+		   against the new word
+		*/
+		for (j=FindSynonym(wd[i], 1); j; j=FindSynonym(wd[i], j+1))
 		{
+			synptr = 2 + (j-1)*5;
 			defseg = syntable;
-			if (wd[i]==PeekWord(synptr + 1))
+			switch (Peek(synptr))
 			{
-				switch (Peek(synptr))
+				case 0:        /* synonym */
 				{
-					case 0:        /* synonym */
+					defseg = syntable;
+					wd[i] = PeekWord(synptr + 3);
+					m = strlen(GetWord(wd[i])) - strlen(word[i]);
+					if (m)
 					{
-						defseg = syntable;
-						wd[i] = PeekWord(synptr + 3);
-						m = strlen(GetWord(wd[i])) - strlen(word[i]);
-						if (m)
-						{
-							if (m + (int)strlen(buffer) > 81)
-								{strcpy(buffer, "");
-								words = 0;
-								ParseError(0, 0);
-								return 0;}
+						if (m + (int)strlen(buffer) > 81)
+							{strcpy(buffer, "");
+							words = 0;
+							ParseError(0, 0);
+							return 0;}
 
-							for (k=words; k>i; k--)
-							{
-								strcpy(tempword, word[k]);
-								word[k] += m;
-								strcpy(word[k], tempword);
-							}
+						for (k=words; k>i; k--)
+						{
+							strcpy(tempword, word[k]);
+							word[k] += m;
+							strcpy(word[k], tempword);
 						}
-						strcpy(word[i], GetWord(wd[i]));
-						i--;
-						break;
 					}
+					strcpy(word[i], GetWord(wd[i]));
+					i--;
+					break;
+				}
 
-					case 1:        /* removal */
-					{
-						KillWord(i);
-						i--;
-						break;
-					}
+				case 1:        /* removal */
+				{
+					KillWord(i);
+					i--;
+					break;
+				}
 
-					case 2:        /* compound */
+				case 2:        /* compound */
+				{
+					if (wd[i+1]==PeekWord(synptr+3))
 					{
-						if (wd[i+1]==PeekWord(synptr+3))
-						{
-							strcat(word[i], word[i+1]);
-							wd[i] = FindWord(word[i]);
-							KillWord(i+1);
-						}
-						break;
+						strcat(word[i], word[i+1]);
+						wd[i] = FindWord(word[i]);
+						KillWord(i+1);
 					}
+					break;
 				}
-				goto NextSyn;
 			}
-NextSyn:
-			synptr += 5;
 		}
 
 		if (wd[i]==comma)
@@ -2544,6 +2686,28 @@ void RemoveWord(int a)
 }
 
 
+/* RESETAVAILABLECACHE
+
+	Forgets all memoized Available() results.
+*/
+
+void ResetAvailableCache(void)
+{
+	int i;
+
+	/* On wrap-around, old entries could look valid again */
+	if (++available_gen==0)
+	{
+		if (available_cache)
+		{
+			for (i=0; i<objects; i++)
+				available_cache[i].gen = 0;
+		}
+		available_gen = 1;
+	}
+}
+
+
 /* RESETFINDOBJECT
 
 	Call FindObject(0, 0) to reset library's disambiguation
@@ -2554,6 +2718,7 @@ void ResetFindObject(void)
 {
 	if (findobjectaddr)
 	{
+		ResetAvailableCache();
 		SetStackFrame(RESET_STACK_DEPTH, RUNROUTINE_BLOCK, 0, 0);
 		PassLocals(0);
 #if defined (DEBUGGER)
@@ -2571,30 +2736,22 @@ void ResetFindObject(void)
 	Splits <buffer> into the word[] array.  Also does nifty things
 	such as turning time values such as hh:mm into a single number
 	(representing minutes from midnight).
+
+	This is done in a single pass over the input, using the
+	character classes from SetupPunctuation().
 */
 
 void SeparateWords(void)
 {
 	char inquote = 0;
-	char a[1025];
-	char b[2];
-	char w1[17], w2[17];            /* for time conversions */
-	char temp[17];
-	short n1, n2;                   /* must be 16 bits */
+	char a[MAXBUFFER+MAXWORDS];
+	unsigned char c, cl;
 	int bloc = 0;                   /* buffer location */
-	int i;
+	int i, len, n;
 
+	len = strlen(buffer);
+	memcpy(a, buffer, len);
 
-	/* First filter the line of any user-specified punctuation */
-	do
-	{
-		i = strcspn(buffer, punc_string);
-		if (buffer[i]) buffer[i] = ' ';
-	} while (buffer[i]);
-
-
-	/* Begin the word-splitting proper: */
-	
 	words = 1;                      /* Setup a blank string */
 
 	for (i=0; i<MAXWORDS+1; i++)
@@ -2603,91 +2760,250 @@ void SeparateWords(void)
 		wd[i] = 0;
 	}
 	word[1] = buffer;
+	buffer[0] = '\0';
 
-	strcpy(a, buffer);
-	strcpy(buffer, "");
-	
-	for (i=1; i<=(int)strlen(a); i++)
+	for (i=0; i<len; i++)
 	{
-		if (inquote!=1 && isascii(a[i-1]))
-			b[0] = (char)tolower(a[i-1]);
-		else b[0] = a[i-1];
-		b[1] = '\0';
+		c = (unsigned char)a[i];
+
+		/* Any user-specified punctuation is just a space */
+		if ((cl = char_class[c])==CC_PUNCTUATION)
+		{
+			c = ' ';
+			cl = CC_SPACE;
+		}
 
-		if (b[0]=='\"' && inquote==1)
+		if (inquote!=1 && isascii(c))
+			c = (unsigned char)tolower(c);
+
+		if (cl==CC_QUOTE && inquote==1)
 		{
-			strcpy(buffer+bloc, b);
-			bloc++;
+			buffer[bloc++] = '\"';
+			buffer[bloc] = '\0';
 			inquote++;
 		}
 
-		if (b[0]=='\"' || ((b[0]==' ' || b[0]=='!' || b[0]=='?') && inquote!=1))
+		if (cl==CC_QUOTE || (cl==CC_SPACE && inquote!=1))
 		{
 			if (word[words][0]!='\0')
 			{
 				bloc++;
 				if (++words > MAXWORDS) words = MAXWORDS;
 				word[words] = buffer + bloc;
-				strcpy(word[words], "");
+				buffer[bloc] = '\0';
 			}
 
-			if (b[0]=='\"' && inquote==0)
+			if (cl==CC_QUOTE && inquote==0)
 			{
-				strcpy(buffer+bloc, b);
-				bloc++;
+				buffer[bloc++] = '\"';
+				buffer[bloc] = '\0';
 				inquote = 1;
 			}
 		}
-		else
+
+		/* '.' and ',' are words by themselves */
+		else if (cl==CC_STOP && inquote!=1)
 		{
-			if ((b[0]=='.' || b[0]==',') && inquote!=1)
-			{
-				if (word[words][0]!='\0')
-				{
-					bloc++;
-					if (++words > MAXWORDS) words = MAXWORDS;
-				}
-				word[words] = buffer + bloc;
-				strcpy(word[words], b);
-				bloc += strlen(b) + 1;
-				if (++words > MAXWORDS) words = MAXWORDS;
-				word[words] = buffer + bloc;
-				strcpy(word[words], "");
-			}
-			else
+			if (word[words][0]!='\0')
 			{
-				strcpy(buffer+bloc, b);
 				bloc++;
+				if (++words > MAXWORDS) words = MAXWORDS;
 			}
+			word[words] = buffer + bloc;
+			buffer[bloc++] = (char)c;
+			buffer[bloc++] = '\0';
+			if (++words > MAXWORDS) words = MAXWORDS;
+			word[words] = buffer + bloc;
+			buffer[bloc] = '\0';
+		}
+		else
+		{
+			buffer[bloc++] = (char)c;
+			buffer[bloc] = '\0';
 		}
 	}
 
-	if (!strcmp(word[words], "")) words--;
+	if (word[words][0]=='\0') words--;
 
 	for (i=1; i<=words; i++)
 	{
-		/* Convert hours:minutes time to minutes only */
-		if (strcspn(word[i], ":")!=strlen(word[i]) && strlen(word[i])<=5)
+		/* Convert hours:minutes time to minutes only, storing
+		   the original hh:mm in parse$
+		*/
+		if (strchr(word[i], ':') && strlen(word[i])<=5 && (n = TimeValue(word[i]))!=-1)
 		{
-			strcpy(w1, Left(word[i], strcspn(word[i], ":")));
-			strcpy(w2, Right(word[i], strlen(word[i]) - strcspn(word[i], ":") - 1));
-			n1 = (short)atoi(w1);
-			n2 = (short)atoi(w2);
+			strcpy(parseerr, word[i]);
+			itoa(n, word[i], 10);
+		}
+	}
+}
 
-			if (!strcmp(Left(w2, 1), "0"))
-				strcpy(w2, Right(w2, strlen(w2) - 1));
 
-			/* If this is indeed a hh:mm time, write it back
-			   as the modified word, storing the original hh:mm
-			   in parse$:
-			*/
-			if (!strcmp(w1, itoa((int)n1, temp, 10)) && !strcmp(w2, itoa((int)n2, temp, 10)) && (n1 > 0 && n1 < 25) && (n2 >= 0 && n2 < 60))
-			{
-				strcpy(parseerr, word[i]);
-				itoa(n1 * 60 + n2, word[i], 10);
-			}
-		}
+/* SETUPPUNCTUATION
+
+	Builds the character class table used by SeparateWords(),
+	including the game's own punctuation (see LoadGame()).
+*/
+
+void SetupPunctuation(void)
+{
+	int i;
+
+	for (i=0; i<256; i++)
+		char_class[i] = CC_LETTER;
+
+	char_class[' '] = char_class['!'] = char_class['?'] = CC_SPACE;
+	char_class['\"'] = CC_QUOTE;
+	char_class['.'] = char_class[','] = CC_STOP;
+
+	for (i=0; punc_string[i]!='\0'; i++)
+		char_class[(unsigned char)punc_string[i]] = CC_PUNCTUATION;
+}
+
+
+/* OBJLISTPOS
+
+	Returns the position of <obj> in objlist[], or -1 if it isn't
+	there.  PossibleObjPos() does the same for pobjlist[].
+*/
+
+static int ObjListPos(int obj)
+{
+	int i;
+
+	if (OBJ_INDEXED(obj))
+	{
+		i = objlist_pos[obj];
+		return (i<objcount && objlist[i]==obj)?i:-1;
+	}
+
+	for (i=0; i<objcount; i++)
+	{
+		if (objlist[i]==obj) return i;
 	}
+	return -1;
+}
+
+static int PossibleObjPos(int obj)
+{
+	int i;
+
+	if (OBJ_INDEXED(obj))
+	{
+		i = pobjlist_pos[obj];
+		return (i<pobjcount && pobjlist[i].obj==obj)?i:-1;
+	}
+
+	for (i=0; i<pobjcount; i++)
+	{
+		if (pobjlist[i].obj==obj) return i;
+	}
+	return -1;
+}
+
+
+/* INDEXOBJLISTS
+
+	Brings objlist_pos[] and pobjlist_pos[] up to date after objlist[]
+	or pobjlist[] have been written to directly.
+*/
+
+static void IndexObjLists(void)
+{
+	int i;
+
+	for (i=0; i<objcount; i++)
+	{
+		if (OBJ_INDEXED(objlist[i])) objlist_pos[objlist[i]] = (unsigned char)i;
+	}
+	for (i=0; i<pobjcount; i++)
+	{
+		if (OBJ_INDEXED(pobjlist[i].obj)) pobjlist_pos[pobjlist[i].obj] = (unsigned char)i;
+	}
+}
+
+
+/* SETUPOBJLISTS
+
+	Allocates the object position tables used by InList(), AddObj(),
+	etc.  If there isn't enough memory, the lists are searched instead.
+*/
+
+void SetupObjLists(void)
+{
+	if (objlist_pos) hugo_blockfree(objlist_pos);
+	if (pobjlist_pos) hugo_blockfree(pobjlist_pos);
+	objlist_pos = pobjlist_pos = NULL;
+	objlist_pos_size = 0;
+
+	if (objects<=0) return;
+
+	objlist_pos = (unsigned char *)hugo_blockalloc(sizeof(unsigned char)*objects);
+	pobjlist_pos = (unsigned char *)hugo_blockalloc(sizeof(unsigned char)*objects);
+	if (objlist_pos==NULL || pobjlist_pos==NULL)
+	{
+		if (objlist_pos) hugo_blockfree(objlist_pos);
+		if (pobjlist_pos) hugo_blockfree(pobjlist_pos);
+		objlist_pos = pobjlist_pos = NULL;
+		return;
+	}
+	memset(objlist_pos, 0, sizeof(unsigned char)*objects);
+	memset(pobjlist_pos, 0, sizeof(unsigned char)*objects);
+	objlist_pos_size = objects;
+}
+
+
+/* SETUPSYNONYMS
+
+	Indexes the synonym table (see LoadGame()) so that Parse()
+	doesn't have to go through all of it for every word.  If
+	there isn't enough memory, FindSynonym() does it the slow way.
+*/
+
+void SetupSynonyms(void)
+{
+	int j, *tail;
+	unsigned int size, h;
+
+	if (syn_head) hugo_blockfree(syn_head);
+	if (syn_next) hugo_blockfree(syn_next);
+	syn_head = syn_next = NULL;
+	syn_generation = MemGeneration(SYNONYM_REGION);
+
+	if (syncount<=0) return;
+
+	/* At least twice as many buckets as records */
+	for (size=16; size < (unsigned int)syncount*2; size*=2);
+
+	syn_head = (int *)hugo_blockalloc(sizeof(int)*size);
+	syn_next = (int *)hugo_blockalloc(sizeof(int)*(syncount+1));
+	tail = (int *)hugo_blockalloc(sizeof(int)*size);
+	if (syn_head==NULL || syn_next==NULL || tail==NULL)
+	{
+		if (syn_head) hugo_blockfree(syn_head);
+		if (syn_next) hugo_blockfree(syn_next);
+		if (tail) hugo_blockfree(tail);
+		syn_head = syn_next = NULL;
+		return;
+	}
+	memset(syn_head, 0, sizeof(int)*size);
+	syn_hashmask = size-1;
+
+	/* Append each record to its bucket, keeping them in order */
+	defseg = syntable;
+	for (j=1; j<=syncount; j++)
+	{
+		h = SYN_HASH(PeekWord(2 + (j-1)*5 + 1)) & syn_hashmask;
+		syn_next[j] = 0;
+		if (syn_head[h])
+			syn_next[tail[h]] = j;
+		else
+			syn_head[h] = j;
+		tail[h] = j;
+	}
+	defseg = gameseg;
+
+	hugo_blockfree(tail);
 }
 
 
@@ -2698,18 +3014,17 @@ void SeparateWords(void)
 
 void SubtractObj(int obj)
 {
-	int i, j;
+	int i;
 
-	for (i=0; i<objcount; i++)
+	if ((i = ObjListPos(obj))==-1)
+		return;
+
+	for (; i+1<objcount; i++)
 	{
-		if (objlist[i]==obj)
-		{
-			for (j=i; j<objcount; j++)
-				objlist[j] = objlist[j+1];
-			objcount--;
-			return;
-		}
+		objlist[i] = objlist[i+1];
+		if (OBJ_INDEXED(objlist[i])) objlist_pos[objlist[i]] = (unsigned char)i;
 	}
+	objcount--;
 }
 
 
@@ -2720,19 +3035,20 @@ void SubtractObj(int obj)
 
 void SubtractPossibleObject(int obj)
 {
-	int i, j, last = 0;
+	int i, last;
 
-	for (i=0; i<pobjcount; i++)
-	{
-		if (pobjlist[i].obj==obj)
-		{
-			if (pobjlist[i].obj==pobj && last!=0) pobj = last;
+	if ((i = PossibleObjPos(obj))==-1)
+		return;
 
-			for (j=i; j+1<pobjcount; j++)
-			{
-				pobjlist[j] = pobjlist[j+1];
-			}
-			pobjcount--;
+	last = (i > 0)?pobjlist[i-1].obj:0;
+	if (obj==pobj && last!=0) pobj = last;
+
+	for (; i+1<pobjcount; i++)
+	{
+		pobjlist[i] = pobjlist[i+1];
+		if (OBJ_INDEXED(pobjlist[i].obj)) pobjlist_pos[pobjlist[i].obj] = (unsigned char)i;
+	}
+	pobjcount--;
 
 #ifdef DEBUG_PARSER
 {
@@ -2741,10 +3057,33 @@ void SubtractPossibleObject(int obj)
 	Printout(buf);
 }
 #endif
-			return;
-		}
-		else last = pobjlist[i].obj;
-	}
+}
+
+
+/* TIMEVALUE
+
+	Returns the minutes from midnight if <a> is a time in the form
+	hh:mm (with hours from 1 to 24), or -1 otherwise.
+*/
+
+int TimeValue(char *a)
+{
+	int h = 0, m = 0;
+
+	/* Hours, without a leading zero */
+	if (*a<'1' || *a>'9') return -1;
+	while (*a>='0' && *a<='9')
+		h = h*10 + *a++ - '0';
+	if (*a++!=':' || h > 24) return -1;
+
+	/* Minutes, with at most one leading zero */
+	if (*a=='0') a++;
+	if (*a<'0' || *a>'9' || (*a=='0' && a[1]!='\0')) return -1;
+	while (*a>='0' && *a<='9')
+		m = m*10 + *a++ - '0';
+	if (*a!='\0' || m >= 60) return -1;
+
+	return h*60 + m;
 }
 
 
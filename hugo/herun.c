@@ -39,6 +39,14 @@ int last_window_top, last_window_bottom, last_window_left, last_window_right;
 int lowest_windowbottom = 0,			/* in text lines */
 	physical_lowest_windowbottom;		/* in pixels or text lines */
 char just_left_window = false;
+
+#if defined (TIMESLICE_DEFINED)
+/* Statements RunRoutine() runs between calls to hugo_timeslice();
+   set by the port, 0 disables
+*/
+long timeslice_statements = 0;
+long timeslice_count = 0;
+#endif
 	
 /* from heparse.c, for RunEvents() */
 extern int parse_location;
@@ -80,6 +88,11 @@ void RunEvents(void)
 	int tempdbnest;
 #endif
 
+	/* The command may have changed things without going through
+	   SaveUndo() (restore, restart, etc.)
+	*/
+	ResetAvailableCache();
+
 	tempundo = undorecord;
 	undorecord = true;
 
@@ -960,6 +973,75 @@ void RunMove(void)
 }
 
 
+#if defined (NATIVE_ROUTINES)
+
+static char native_routines_enabled = false;
+
+/* Set by ResumeRoutine() for the RunRoutine() call it makes */
+static int resume_stack_depth = -1;
+
+/* CHECKNATIVEROUTINES
+
+	Called once the game is loaded.  Translated routines are only used
+	if they were generated from this same game file.
+*/
+
+void CheckNativeRoutines(void)
+{
+	native_routines_enabled = (native_routine_count > 0
+		&& !strcmp(native_routine_serial, serial)
+		&& native_routine_codeend==codeend);
+}
+
+
+/* RUNNATIVEROUTINE
+
+	Runs the translated version of the routine at <addr>, if there is
+	one.  Returns false if the routine has to be interpreted.
+*/
+
+int RunNativeRoutine(long addr)
+{
+	int lo, hi, mid;
+
+	if (!native_routines_enabled) return false;
+
+	lo = 0;
+	hi = native_routine_count - 1;
+	while (lo <= hi)
+	{
+		mid = (lo + hi)/2;
+		if (native_routine_table[mid].addr < addr)
+			lo = mid + 1;
+		else if (native_routine_table[mid].addr > addr)
+			hi = mid - 1;
+		else
+		{
+			native_routine_table[mid].run();
+			defseg = gameseg;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/* RESUMEROUTINE
+
+	Called by a translated routine to have the rest of it, starting
+	at codeptr, interpreted.  <depth> is the stack depth the routine
+	was entered at, which labels are reconciled against.
+*/
+
+void ResumeRoutine(int depth)
+{
+	resume_stack_depth = depth;
+	RunRoutine(codeptr);
+}
+
+#endif	/* defined (NATIVE_ROUTINES) */
+
+
 /* RUNPRINT */
 
 void RunPrint(void)
@@ -1155,6 +1237,10 @@ int RunRestart()
 	if (!(file = HUGO_FOPEN(gamefile, "rb"))) goto RestartError;
 	LoadGameData(true);
 	hugo_fclose(file);
+
+	/* LoadGameData() doesn't go through SETMEM() */
+	BuildAttributeIndex();
+	SetupSynonyms();
 #endif	/* LOADGAMEDATA_REPLACED */
 
 	defseg = arraytable;
@@ -1315,6 +1401,11 @@ int RestoreGameData(void)
 		undoturn = lbyte + hbyte*256;
 		if ((lbyte = hugo_fgetc(save))==EOF || (hbyte = hugo_fgetc(save))==EOF) goto RestoreError;
 		undoinvalid = (unsigned char)lbyte, undorecord = (unsigned char)hbyte;
+
+		/* In case the file was saved without undoinvalid set for
+		   these (see UndoHasArrayData())
+		*/
+		if (UndoHasArrayData()) undoinvalid = true;
 	}
 	else undoinvalid = true;
 
@@ -1441,6 +1532,20 @@ void RunRoutine(long addr)
 	initial_stack_depth = stack_depth;
 	inexpr = 0;
 
+#if defined (NATIVE_ROUTINES) && !defined (DEBUGGER)
+	/* A routine call (as opposed to, e.g., a 'window' block, where
+	   codeptr is already at addr) may have a translated version.
+	   A translated routine handing the rest of itself back to us
+	   tells us the depth it was entered at.
+	*/
+	if (resume_stack_depth >= 0)
+	{
+		initial_stack_depth = resume_stack_depth;
+		resume_stack_depth = -1;
+	}
+	else if (codeptr!=addr && RunNativeRoutine(addr)) return;
+#endif
+
 #if !defined (DEBUGGER)
 #if defined (DEBUG_CODE)
 /*
@@ -1561,6 +1666,21 @@ ContinueRunning:
 #endif
 		if (var[endflag]) return;
 
+#if defined (TIMESLICE_DEFINED)
+		/* Let the port show pending output and check for a quit
+		   request in the middle of long computations
+		*/
+		if (timeslice_statements && ++timeslice_count >= timeslice_statements)
+		{
+			timeslice_count = 0;
+			if (hugo_timeslice(addr))
+			{
+				var[endflag] = -1;
+				return;
+			}
+		}
+#endif
+
 		null_count = 0;
 
 		/* Read the next token */
@@ -1767,15 +1887,12 @@ ProcessToken:
 			case TEXTDATA_T:        /* printed text from file */
 			{
 				textaddr = Peek(codeptr+1)*65536L+(long)PeekWord(codeptr+2);
-				strcpy(line, GetText(textaddr));
 				codeptr += 4;
 				if (Peek(codeptr)==SEMICOLON_T)
-					{strcat(line, "\\;");
+					{RunTextData(textaddr, true);
 					codeptr++;}
-				if (capital)
-					{line[0] = (char)toupper((int)line[0]);
-					capital = 0;}
-				AP(line);
+				else
+					RunTextData(textaddr, false);
 				break;
 			}
 
@@ -2396,8 +2513,14 @@ int SaveGameData(void)
 		goto SaveError;
 	if (hugo_fputc(undoturn-(undoturn/256)*256, save)==EOF || hugo_fputc(undoturn/256, save)==EOF)
 		goto SaveError;
-	if (hugo_fputc(undoinvalid, save)==EOF || hugo_fputc(undorecord, save)==EOF)
+	/* Array range records can't be undone once the game is restored
+	   (see UndoHasArrayData())
+	*/
+	if (hugo_fputc(undoinvalid || UndoHasArrayData(), save)==EOF ||
+		hugo_fputc(undorecord, save)==EOF)
+	{
 		goto SaveError;
+	}
 		
 	return true;
 		
@@ -2682,6 +2805,34 @@ int RunSystem(void)
 }
 
 
+/* RUNTEXTDATA
+
+	Prints the string at <textaddr> in the text bank, as for a string
+	literal statement.  If <sticky> is true, no newline follows.
+*/
+
+void RunTextData(long textaddr, char sticky)
+{
+	/* GetText()'s buffer isn't touched again until the next call, so
+	   it can be printed from directly
+	*/
+	char *t = GetText(textaddr);
+	int len = (int)strlen(t);
+
+	/* The same as AP() does for a "\;" at the end of the text */
+	if (!sticky && len>=2 && t[len-1]==';' && t[len-2]=='\\')
+	{
+		sticky = true;
+		len -= 2;
+	}
+
+	if (capital)
+		{t[0] = (char)toupper((int)t[0]);
+		capital = 0;}
+	APSpan(t, len, sticky);
+}
+
+
 /* RUNWINDOW
 
 	As in 'window [n[, o, p, q]]'.
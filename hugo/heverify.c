@@ -0,0 +1,444 @@
+/*
+	HEVERIFY.C
+
+	Load-time code verification:
+
+		VerifyGame
+
+	for the Hugo Engine
+
+	Every routine that can be reached from the header, the event
+	table and the property table (and, in turn, every routine those
+	call directly) is walked token by token before the game starts.
+	Unknown tokens, stray padding, unbalanced blocks and jumps that
+	leave the routine cause the game to be rejected, instead of the
+	game failing at some later point.  RunRoutine() still does its
+	own checks; the only per-statement one a passing routine would
+	make redundant is the padding count, and skipping it makes no
+	measurable difference.
+*/
+
+#include "heheader.h"
+
+/* from hemisc.c */
+extern int loaded_in_memory;
+
+char verify_code = false;		/* set by the port to enable */
+
+/* One bit per address boundary (i.e., per possible routine address) */
+static unsigned char *routine_queued = NULL;
+static unsigned char *routine_verified = NULL;	/* already scanned */
+
+/* One bit per byte of code; set for every token and padding byte */
+static unsigned char *code_boundary = NULL;
+
+static long verify_filelength;
+static int verify_queued;
+
+#define BIT_SET(map, n)   ((map)[(n)>>3] |= (unsigned char)(1<<((n)&7)))
+#define BIT_TEST(map, n)  ((map)[(n)>>3] & (1<<((n)&7)))
+
+/* A token's data (plus at least the closing '}') has to fit in the code */
+#define NEED(n) if (ptr+(n) >= codeend) goto Invalid
+
+static void QueueRoutine(long addr);
+static long ScanRoutine(long addr, char checktargets);
+static char ScanComplexProperty(long addr);
+static char ValidTarget(long target, long start, long end);
+
+
+/* QUEUEROUTINE */
+
+static void QueueRoutine(long addr)
+{
+	long n = addr/address_scale;
+
+	if (!BIT_TEST(routine_queued, n))
+	{
+		BIT_SET(routine_queued, n);
+		verify_queued++;
+	}
+}
+
+
+/* SCANROUTINE
+
+	Walks the routine at <addr> up to its closing '}', the same way
+	RunRoutine() would read it.  On the first pass, every token
+	position is recorded in code_boundary and called routines are
+	queued.  On the second pass (<checktargets> true), jump and
+	skip targets are checked against those positions.  Returns the
+	address of the closing '}', or -1 with codeptr set to the
+	offending position.
+*/
+
+static long ScanRoutine(long addr, char checktargets)
+{
+	char block[MAXSTACKDEPTH];      /* DO_T or another opener */
+	int depth = 0, null_count = 0;
+	long ptr = addr, end = -1, target, textaddr;
+	unsigned int t;
+
+	/* Need the end of the routine to check targets against */
+	if (checktargets && (end = ScanRoutine(addr, false))==-1)
+		return -1;
+
+	while (ptr < codeend)
+	{
+		if ((t = MEM(ptr))==0)
+		{
+			/* Padding to the next address boundary */
+			if (++null_count > address_scale) goto Invalid;
+			if (!checktargets) BIT_SET(code_boundary, ptr);
+			ptr++;
+			continue;
+		}
+		null_count = 0;
+
+		if (t > TOKENS) goto Invalid;
+		if (!checktargets) BIT_SET(code_boundary, ptr);
+
+		switch (t)
+		{
+			case CLOSE_BRACE_T:
+			{
+				if (depth==0) return ptr;
+
+				if (block[--depth]==DO_T)
+				{
+					/* "do {...} while <expr>":  the
+					   'while' doesn't open a block
+					*/
+					NEED(4);
+					if (MEM(ptr+1)!=WHILE_T) goto Invalid;
+					if (!checktargets) BIT_SET(code_boundary, ptr+1);
+					ptr += 3;
+				}
+				ptr++;
+				break;
+			}
+
+			case IF_T:
+			case ELSEIF_T:
+			case ELSE_T:
+			case WHILE_T:
+			case FOR_T:
+			case CASE_T:
+			case DO_T:
+			case READFILE_T:
+			case WRITEFILE_T:
+			{
+				NEED(3);
+				if (depth==MAXSTACKDEPTH) goto Invalid;
+				block[depth++] = (char)t;
+
+				if (checktargets)
+				{
+					if (t==READFILE_T || t==WRITEFILE_T)
+						target = (long)PeekWord(ptr+1)*address_scale;
+					else
+						target = ptr+1+PeekWord(ptr+1);
+					if (!ValidTarget(target, addr, end)) goto Invalid;
+				}
+				ptr += 3;
+				break;
+			}
+
+			case WINDOW_T:
+			{
+				/* "window 0" is the only form without a block */
+				NEED(5);
+				if (MEM(ptr+1)==VALUE_T && PeekWord(ptr+2)==0 && MEM(ptr+4)==EOL_T)
+				{
+					ptr++;
+					break;
+				}
+				if (depth==MAXSTACKDEPTH) goto Invalid;
+				block[depth++] = (char)t;
+				ptr++;
+				break;
+			}
+
+			case JUMP_T:
+			{
+				NEED(3);
+				if (checktargets)
+				{
+					target = (long)PeekWord(ptr+1)*address_scale;
+					if (!ValidTarget(target, addr, end)) goto Invalid;
+				}
+				ptr += 3;
+				break;
+			}
+
+			case ROUTINE_T:
+			{
+				NEED(3);
+				target = (long)PeekWord(ptr+1)*address_scale;
+				if (target >= codeend) goto Invalid;
+				if (target && !checktargets) QueueRoutine(target);
+				ptr += 3;
+				break;
+			}
+
+			case TEXTDATA_T:
+			{
+				NEED(4);
+				textaddr = MEM(ptr+1)*65536L + (long)PeekWord(ptr+2);
+				if (loaded_in_memory && (codeend+textaddr+2 > verify_filelength ||
+					codeend+textaddr+2+MEM(codeend+textaddr)+MEM(codeend+textaddr+1)*256 > verify_filelength))
+				{
+					goto Invalid;
+				}
+				ptr += 4;
+				break;
+			}
+
+			case STRINGDATA_T:
+				NEED(3);
+				ptr += 3 + PeekWord(ptr+1);
+				break;
+
+			case DEBUGDATA_T:
+			{
+				/* Local variable names are the only debug data */
+				NEED(3);
+				if (MEM(ptr+1)!=VAR_T) goto Invalid;
+				ptr += 3 + MEM(ptr+2);
+				break;
+			}
+
+			case VALUE_T:
+			case OBJECTNUM_T:
+			case DICTENTRY_T:
+			case ARRAYDATA_T:
+				NEED(3);
+				ptr += 3;
+				break;
+
+			case VAR_T:
+			case ATTR_T:
+			case PROP_T:
+			case LABEL_T:
+				NEED(2);
+				ptr += 2;
+				break;
+
+			default:
+				ptr++;
+		}
+	}
+
+	/* Ran off the end of the code without a closing '}' */
+	ptr = codeend;
+
+Invalid:
+	codeptr = ptr;
+	return -1;
+}
+
+
+/* SCANCOMPLEXPROPERTY
+
+	A complex property such as before or after isn't a routine, but
+	a chain of entries, the same way GetProp() reads it:  an object
+	expression and any verbroutines, a jump to the next entry, and
+	then the entry's body up to its closing '}'.  The chain ends
+	with a '}' where the next entry would start.  Each body is
+	scanned as a routine of its own.  Returns false with codeptr
+	set to the offending position.
+*/
+
+static char ScanComplexProperty(long addr)
+{
+	long ptr = addr, end, next, target;
+	unsigned int t;
+
+	defseg = gameseg;
+
+	while (ptr < codeend && MEM(ptr)!=CLOSE_BRACE_T)
+	{
+		/* The entry's header, up to the jump to the next entry */
+		while ((t = MEM(ptr))!=JUMP_T)
+		{
+			if (t==0 || t > TOKENS || t==CLOSE_BRACE_T) goto Invalid;
+
+			switch (t)
+			{
+				case ROUTINE_T:
+					NEED(3);
+					target = (long)PeekWord(ptr+1)*address_scale;
+					if (target >= codeend) goto Invalid;
+					if (target) QueueRoutine(target);
+					ptr += 3;
+					break;
+
+				case VALUE_T:
+				case OBJECTNUM_T:
+				case DICTENTRY_T:
+				case ARRAYDATA_T:
+					NEED(3);
+					ptr += 3;
+					break;
+
+				case VAR_T:
+				case ATTR_T:
+				case PROP_T:
+					NEED(2);
+					ptr += 2;
+					break;
+
+				default:
+					NEED(1);
+					ptr++;
+			}
+		}
+		NEED(3);
+		next = (long)PeekWord(ptr+1)*address_scale;
+
+		if ((end = ScanRoutine(ptr+3, true))==-1) return false;
+
+		/* The next entry has to follow this one's body */
+		if (next <= end || next >= codeend) goto Invalid;
+		ptr = next;
+	}
+	if (ptr < codeend) return true;
+
+	ptr = codeend;
+
+Invalid:
+	codeptr = ptr;
+	return false;
+}
+
+
+/* VALIDTARGET
+
+	A jump or skip target has to land on a token (or padding) within
+	the routine.
+*/
+
+static char ValidTarget(long target, long start, long end)
+{
+	if (target < start || target > end) return false;
+
+	return BIT_TEST(code_boundary, target)?true:false;
+}
+
+
+/* VERIFYGAME
+
+	Called from LoadGame() if verify_code is set.  <filelength> is
+	the size of the game file, for checking text bank addresses.
+	Rejects the game with a fatal error if any reachable routine
+	fails verification.
+*/
+
+void VerifyGame(long filelength)
+{
+	int i, obj, p, proplen;
+	unsigned int ptr, routines;
+	long n, addr;
+
+	/* Older games encode some statements differently */
+	if (game_version < 25) return;
+
+	verify_filelength = filelength;
+	routines = (unsigned int)(codeend/address_scale) + 1;
+
+	if (routine_queued) hugo_blockfree(routine_queued);
+	if (routine_verified) hugo_blockfree(routine_verified);
+	if (code_boundary) hugo_blockfree(code_boundary);
+	routine_verified = NULL;
+
+	if ((routine_queued = (unsigned char *)hugo_blockalloc((routines+7)/8))==NULL ||
+		(code_boundary = (unsigned char *)hugo_blockalloc((codeend+7)/8))==NULL)
+	{
+		FatalError(MEMORY_E);
+	}
+	memset(routine_queued, 0, (routines+7)/8);
+	memset(code_boundary, 0, (codeend+7)/8);
+	verify_queued = 0;
+
+	/* Junction routines from the header */
+	defseg = gameseg;
+	for (i=H_INIT; i<=H_PERFORM; i+=2)
+	{
+		if ((addr = (long)PeekWord(i)*address_scale)!=0 && addr < codeend)
+			QueueRoutine(addr);
+	}
+
+	/* Events */
+	defseg = eventtable;
+	for (i=0; i<events; i++)
+	{
+		if ((addr = (long)PeekWord(2 + i*4 + 2)*address_scale)!=0 && addr < codeend)
+			QueueRoutine(addr);
+	}
+
+	if ((routine_verified = (unsigned char *)hugo_blockalloc((routines+7)/8))==NULL)
+		FatalError(MEMORY_E);
+	memset(routine_verified, 0, (routines+7)/8);
+
+	/* Property routines.  Complex property chains get scanned right
+	   away, and are marked as verified so that objects inheriting
+	   the same chain don't scan it again.
+	*/
+	for (obj=0; obj<objects; obj++)
+	{
+		defseg = objtable;
+		ptr = PeekWord(object_size*(obj+1));
+
+		defseg = proptable;
+		while ((p = Peek(ptr))!=PROP_END)
+		{
+			proplen = Peek(ptr + 1);
+			if (proplen==PROP_ROUTINE)
+			{
+				if ((addr = (long)PeekWord(ptr+2)*address_scale)!=0 && addr < codeend)
+				{
+					if ((Peek(2 + Peek(0)*2 + p) & COMPLEX_FLAG)==0)
+						QueueRoutine(addr);
+					else if (!BIT_TEST(routine_verified, addr/address_scale))
+					{
+						if (!ScanComplexProperty(addr))
+						{
+							hugo_blockfree(routine_verified);
+							routine_verified = NULL;
+							FatalError(ILLEGAL_OP_E);
+						}
+						BIT_SET(routine_verified, addr/address_scale);
+						defseg = proptable;
+					}
+				}
+				proplen = 1;
+			}
+			ptr += proplen*2 + 2;
+		}
+	}
+	defseg = gameseg;
+
+	/* Routines queue the ones they call, so keep going until no
+	   new ones turn up
+	*/
+
+	while (verify_queued)
+	{
+		for (n=0; n<(long)routines; n++)
+		{
+			if (!BIT_TEST(routine_queued, n) || BIT_TEST(routine_verified, n))
+				continue;
+
+			verify_queued--;
+			if (ScanRoutine(n*address_scale, true)==-1)
+			{
+				hugo_blockfree(routine_verified);
+				routine_verified = NULL;
+				FatalError(ILLEGAL_OP_E);
+			}
+			BIT_SET(routine_verified, n);
+		}
+	}
+
+	defseg = gameseg;
+}
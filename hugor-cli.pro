@@ -0,0 +1,79 @@
+# Text-only terminal frontend. Doesn't use Qt at all; qmake is only used to generate the makefile:
+#
+#   qmake hugor-cli.pro
+#   make -jN
+TEMPLATE = app
+CONFIG -= qt app_bundle
+CONFIG += console silent warn_on strict_c++ c++1z thread
+TARGET = hugor-cli
+
+VERSION_MAJOR = 2
+VERSION_MINOR = 2
+VERSION_PATCH = 99
+VERSION = "$$VERSION_MAJOR"."$$VERSION_MINOR"."$$VERSION_PATCH"
+DEFINES += \
+    HUGOR_VERSION=\\\"$$VERSION\\\" \
+    HUGOR_VERSION_MAJOR=$$VERSION_MAJOR \
+    HUGOR_VERSION_MINOR=$$VERSION_MINOR \
+    HUGOR_VERSION_PATCH=$$VERSION_PATCH
+
+# We use warn_off to allow only default warnings, not to supress them all.
+QMAKE_CXXFLAGS_WARN_OFF =
+QMAKE_CFLAGS_WARN_OFF =
+
+*-g++*|*-clang* {
+    # Avoid "unused parameter" warnings with C code.
+    QMAKE_CFLAGS_WARN_ON += -Wno-unused-parameter
+}
+
+INCLUDEPATH += src hugo
+OBJECTS_DIR = obj-cli
+
+DEFINES += HUGOR DISABLE_AUDIO DISABLE_VIDEO
+
+# Routines translated to C with "hugor-cli --translate". The interpreter is still used for anything
+# that wasn't translated, and for all other games.
+!isEmpty(NATIVE_ROUTINES) {
+    DEFINES += NATIVE_ROUTINES
+    SOURCES += $$NATIVE_ROUTINES
+}
+
+HEADERS += \
+    src/heqtheader.h \
+    src/framepacer.h \
+    src/hextrans.h \
+    src/hugodefs.h \
+    src/hugohandlers.h \
+    src/hugorfile.h \
+    \
+    hugo/heheader.h \
+    hugo/htokens.h
+
+SOURCES += \
+    src/hecli.cc \
+    src/framepacer.cc \
+    src/hextrans.cc \
+    src/hugorfile.cc \
+    src/soundnone.cc \
+    \
+    hugo/he.c \
+    hugo/hebuffer.c \
+    hugo/heexpr.c \
+    hugo/hemisc.c \
+    hugo/heobject.c \
+    hugo/heparse.c \
+    hugo/heres.c \
+    hugo/herun.c \
+    hugo/heset.c \
+    hugo/heverify.c \
+    hugo/stringfn.c
+
+isEmpty(PREFIX) {
+    PREFIX = /usr/local
+}
+isEmpty(BINDIR) {
+    BINDIR = "$$PREFIX/bin"
+}
+
+target.path = "$$BINDIR"
+INSTALLS += target
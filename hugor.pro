@@ -183,6 +183,13 @@ CONFIG(debug, debug|release) {
     DEFINES += BOOST_CB_ENABLE_DEBUG=1
 }
 
+# Routines translated to C with "hugor-cli --translate". The interpreter is still used for anything
+# that wasn't translated, and for all other games.
+!isEmpty(NATIVE_ROUTINES) {
+    DEFINES += NATIVE_ROUTINES
+    SOURCES += $$NATIVE_ROUTINES
+}
+
 RESOURCES += resources.qrc
 
 FORMS += \
@@ -208,6 +215,12 @@ HEADERS += \
     src/opcodeparser.h \
     src/util.h \
     src/extcolors.h \
+    src/fontmetricssnapshot.h \
+    src/displayqueue.h \
+    src/screenmodel.h \
+    src/scrollbackbuffer.h \
+    src/scrollbackindex.h \
+    src/framepacer.h \
     \
     hugo/heheader.h \
     hugo/htokens.h
@@ -231,6 +244,12 @@ SOURCES += \
     src/extcolors.cc \
     src/hugorfile.cc \
     src/util.cc \
+    src/fontmetricssnapshot.cc \
+    src/displayqueue.cc \
+    src/screenmodel.cc \
+    src/scrollbackbuffer.cc \
+    src/scrollbackindex.cc \
+    src/framepacer.cc \
     \
     hugo/he.c \
     hugo/hebuffer.c \
@@ -241,6 +260,7 @@ SOURCES += \
     hugo/heres.c \
     hugo/herun.c \
     hugo/heset.c \
+    hugo/heverify.c \
     hugo/stringfn.c
 
 appdataxml.files = desktop/nikos.chantziaras.hugor.appdata.xml
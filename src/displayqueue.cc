@@ -0,0 +1,156 @@
+// This is copyrighted software. More information is at the end of this file.
+#include "displayqueue.h"
+
+#include <QThread>
+
+#include "hframe.h"
+#include "hmainwindow.h"
+
+DisplayQueue* hDisplayQueue = nullptr;
+
+DisplayQueue::DisplayQueue(QObject* parent)
+    : QObject(parent)
+{
+    hDisplayQueue = this;
+}
+
+DisplayCommand& DisplayQueue::beginPush(const DisplayCommand::Type type)
+{
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+
+    // Full. Make sure the GUI thread knows there's work to do and give it time to catch up.
+    while (tail - head_.load(std::memory_order_acquire) >= CAPACITY) {
+        requestDrain();
+        QThread::msleep(1);
+    }
+    auto& cmd = ring_[tail & (CAPACITY - 1)];
+    cmd.type = type;
+    return cmd;
+}
+
+void DisplayQueue::endPush()
+{
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1);
+    requestDrain();
+}
+
+void DisplayQueue::requestDrain()
+{
+    if (not drain_pending_.exchange(true)) {
+        QMetaObject::invokeMethod(this, "drain", Qt::QueuedConnection);
+    }
+}
+
+void DisplayQueue::push(const DisplayCommand::Type type, const int a, const int b, const int c,
+                        const int d, const int e)
+{
+    auto& cmd = beginPush(type);
+    cmd.args = {a, b, c, d, e};
+    endPush();
+}
+
+void DisplayQueue::pushText(const DisplayCommand::Type type, const QString& text, const int x,
+                            const int y)
+{
+    auto& cmd = beginPush(type);
+    cmd.args = {x, y, 0, 0, 0};
+    cmd.text = text;
+    endPush();
+}
+
+void DisplayQueue::pushBytes(const DisplayCommand::Type type, const QByteArray& bytes)
+{
+    auto& cmd = beginPush(type);
+    cmd.bytes = bytes;
+    endPush();
+}
+
+void DisplayQueue::drain()
+{
+    // Some commands might run a local event loop, which might try to drain us again. Let the
+    // engine request drains again (or it would never wake us up), but don't run until we're done.
+    if (draining_) {
+        drain_pending_ = false;
+        redrain_ = true;
+        return;
+    }
+    draining_ = true;
+
+    // Clear this before looking at the tail, so that anything pushed after this point requests a
+    // new drain. We only run what's queued right now; a game that prints without pause would
+    // otherwise keep us from ever getting back to the event loop to paint.
+    drain_pending_ = false;
+
+    size_t head = head_.load(std::memory_order_relaxed);
+    const size_t tail = tail_.load();
+    while (head != tail) {
+        auto& cmd = ring_[head & (CAPACITY - 1)];
+        run(cmd);
+        // Don't keep payloads alive until the slot gets reused.
+        cmd.text = QString();
+        cmd.bytes = QByteArray();
+        head_.store(++head, std::memory_order_release);
+    }
+    draining_ = false;
+
+    if (redrain_) {
+        redrain_ = false;
+        requestDrain();
+    }
+}
+
+void DisplayQueue::run(DisplayCommand& cmd)
+{
+    const auto& a = cmd.args;
+
+    switch (cmd.type) {
+    case DisplayCommand::Type::PrintText:
+        hFrame->printText(cmd.text, a[0], a[1]);
+        break;
+    case DisplayCommand::Type::FlushText:
+        hFrame->flushText();
+        break;
+    case DisplayCommand::Type::ScrollUp:
+        hFrame->scrollUp(a[0], a[1], a[2], a[3], a[4]);
+        break;
+    case DisplayCommand::Type::ClearRegion:
+        hFrame->clearRegion(a[0], a[1], a[2], a[3]);
+        break;
+    case DisplayCommand::Type::SetFgColor:
+        hFrame->setFgColor(a[0]);
+        break;
+    case DisplayCommand::Type::SetBgColor:
+        hFrame->setBgColor(a[0]);
+        break;
+    case DisplayCommand::Type::SetFontType:
+        hFrame->setFontType(a[0]);
+        break;
+    case DisplayCommand::Type::UpdateScreen:
+        hFrame->updateGameScreen(a[0]);
+        break;
+    case DisplayCommand::Type::AppendToScrollback:
+        hMainWin->appendToScrollback(cmd.bytes);
+        break;
+    case DisplayCommand::Type::SetWindowTitle:
+        hMainWin->setWindowTitle(cmd.text);
+        break;
+    }
+}
+
+/* Copyright (C) 2011-2019 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ */
@@ -0,0 +1,118 @@
+// This is copyrighted software. More information is at the end of this file.
+#pragma once
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+#include "util.h"
+
+class DisplayQueue;
+
+extern DisplayQueue* hDisplayQueue;
+
+// A display operation queued by the engine thread. Everything the operation needs is copied into
+// it, so it doesn't matter what the engine does in the meantime.
+struct DisplayCommand final
+{
+    enum class Type
+    {
+        PrintText,
+        FlushText,
+        ScrollUp,
+        ClearRegion,
+        SetFgColor,
+        SetBgColor,
+        SetFontType,
+        UpdateScreen,
+        AppendToScrollback,
+        SetWindowTitle
+    };
+
+    Type type;
+    std::array<int, 5> args;
+    QString text;
+    QByteArray bytes;
+};
+
+/*
+ * Display commands from the engine thread to the GUI thread. The engine thread appends commands to
+ * a single-producer/single-consumer ring without waiting for them to run. The GUI thread runs them
+ * in batches, as many as are queued at the time. Only calls that need a result (input, file
+ * dialogs, etc.) still have to wait for the GUI thread, through runInMainThreadAfterQueue().
+ */
+class DisplayQueue final: public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DisplayQueue(QObject* parent = nullptr);
+
+    // Engine thread only. If the ring is full, waits until the GUI thread makes room.
+    void push(DisplayCommand::Type type, int a = 0, int b = 0, int c = 0, int d = 0, int e = 0);
+    void pushText(DisplayCommand::Type type, const QString& text, int x = 0, int y = 0);
+    void pushBytes(DisplayCommand::Type type, const QByteArray& bytes);
+
+public slots:
+    // GUI thread only. Runs all queued commands.
+    void drain();
+
+private:
+    // Must be a power of two.
+    static constexpr size_t CAPACITY = 4096;
+
+    std::array<DisplayCommand, CAPACITY> ring_;
+
+    // Next slot the GUI thread reads from. Only written by the GUI thread.
+    std::atomic<size_t> head_{0};
+
+    // Next slot the engine thread writes to. Only written by the engine thread.
+    std::atomic<size_t> tail_{0};
+
+    // Set while a drain() has been requested but hasn't started yet, so that we only post one
+    // event per batch.
+    std::atomic<bool> drain_pending_{false};
+
+    // Guards against drain() being re-entered from a nested event loop.
+    bool draining_ = false;
+
+    // Set when a drain() was turned away because one was already running. That one requests
+    // another when it's done, so the commands pushed meanwhile don't get stuck.
+    bool redrain_ = false;
+
+    DisplayCommand& beginPush(DisplayCommand::Type type);
+    void endPush();
+    void requestDrain();
+    void run(DisplayCommand& cmd);
+};
+
+// Runs 'fun' in the GUI thread and waits for it to finish. Display commands queued before the call
+// run first.
+template<typename F>
+void runInMainThreadAfterQueue(F&& fun)
+{
+    runInMainThread([&fun] {
+        hDisplayQueue->drain();
+        fun();
+    });
+}
+
+/* Copyright (C) 2011-2019 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ */
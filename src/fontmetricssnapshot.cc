@@ -0,0 +1,76 @@
+// This is copyrighted software. More information is at the end of this file.
+#include "fontmetricssnapshot.h"
+
+#include <QTextCodec>
+
+extern "C" {
+#include "heheader.h"
+}
+
+FontMetricsSnapshot::FontMetricsSnapshot(const QFont& font, QTextCodec* codec)
+    : font_(font)
+{
+    const QFontMetrics m(font_);
+
+    for (int i = 0; i < 256; ++i) {
+        char c = static_cast<char>(i);
+        if (c == FORCED_SPACE) {
+            c = ' ';
+        }
+        const QString uc = codec->toUnicode(&c, 1);
+        chars_[i] = uc.isEmpty() ? QChar() : uc.at(0);
+        advances_[i] = i < ' ' and c != ' ' ? 0 : m.width(chars_[i]);
+    }
+    average_char_width_ = m.averageCharWidth();
+    line_spacing_ = m.lineSpacing();
+}
+
+int FontMetricsSnapshot::textWidth(const char* str, int len) const
+{
+    // Without kerning, the width of a string is the sum of the widths of its characters.
+    if (not font_.kerning()) {
+        int width = 0;
+        for (int i = 0; i < len; ++i) {
+            if (str[i] == COLOR_CHANGE) {
+                i += 2;
+            } else if (str[i] == FONT_CHANGE) {
+                ++i;
+            } else {
+                width += charWidth(str[i]);
+            }
+        }
+        return width;
+    }
+
+    QString text;
+    text.reserve(len);
+    for (int i = 0; i < len; ++i) {
+        if (str[i] == COLOR_CHANGE) {
+            i += 2;
+        } else if (str[i] == FONT_CHANGE) {
+            ++i;
+        } else {
+            text += chars_[static_cast<unsigned char>(str[i])];
+        }
+    }
+    // QFontMetrics is reentrant, so a local one is safe to use from the engine thread.
+    return QFontMetrics(font_).width(text);
+}
+
+/* Copyright (C) 2011-2019 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ */
@@ -0,0 +1,71 @@
+// This is copyrighted software. More information is at the end of this file.
+#pragma once
+#include <QFont>
+#include <QFontMetrics>
+#include <array>
+#include <memory>
+
+class QTextCodec;
+
+// An immutable copy of the metrics of one font, for use by the engine thread. HFrame creates a new
+// snapshot (rather than modifying the current one) whenever the font or the font settings change,
+// so the engine can keep measuring text with the one it has without racing the GUI thread.
+class FontMetricsSnapshot final
+{
+public:
+    // 'codec' is used to map each of the 256 possible engine characters to Unicode.
+    FontMetricsSnapshot(const QFont& font, QTextCodec* codec);
+
+    const QFont& font() const
+    {
+        return font_;
+    }
+
+    // Width of an engine character. Control characters have no width.
+    int charWidth(char c) const
+    {
+        return advances_[static_cast<unsigned char>(c)];
+    }
+
+    // Width of the first 'len' characters of 'str', skipping color and font change codes.
+    int textWidth(const char* str, int len) const;
+
+    int averageCharWidth() const
+    {
+        return average_char_width_;
+    }
+
+    int lineSpacing() const
+    {
+        return line_spacing_;
+    }
+
+private:
+    QFont font_;
+    std::array<int, 256> advances_;
+    std::array<QChar, 256> chars_;
+    int average_char_width_;
+    int line_spacing_;
+};
+
+// Snapshots of all font variants, indexed by Hugo font type (any combination of BOLD_FONT,
+// ITALIC_FONT, UNDERLINE_FONT and PROP_FONT.)
+using FontMetricsSet = std::array<std::shared_ptr<const FontMetricsSnapshot>, 16>;
+
+/* Copyright (C) 2011-2019 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ */
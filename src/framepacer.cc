@@ -0,0 +1,55 @@
+// This is copyrighted software. More information is at the end of this file.
+#include "framepacer.h"
+
+#include <thread>
+
+// Sleeping is only accurate to a millisecond or two, so we sleep until this close to the deadline,
+// then sleep in short slices until less than a slice is left, and only yield for that last bit.
+static constexpr auto SLEEP_MARGIN = std::chrono::milliseconds(1);
+static constexpr auto SLICE = std::chrono::microseconds(100);
+
+void FramePacer::wait(const int n)
+{
+    const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::seconds(1)) / n;
+    auto now = Clock::now();
+
+    // Start over when the rate changes, or when we're more than a whole period behind (the game
+    // waited for input or did something else for a while.) Otherwise, the next deadline is
+    // exactly one period after the previous one, no matter when we got called.
+    if (n != rate_ or now > deadline_ + period) {
+        rate_ = n;
+        deadline_ = now;
+    }
+    deadline_ += period;
+
+    if (deadline_ - now > SLEEP_MARGIN) {
+        std::this_thread::sleep_until(deadline_ - SLEEP_MARGIN);
+    }
+    while ((now = Clock::now()) + SLICE < deadline_) {
+        std::this_thread::sleep_for(SLICE);
+    }
+    while ((now = Clock::now()) < deadline_) {
+        std::this_thread::yield();
+    }
+
+    const double late = std::chrono::duration<double, std::milli>(now - deadline_).count();
+    lateness_ms_ += (late - lateness_ms_) / 32;
+}
+
+/* Copyright (C) 2011-2019 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ */
@@ -0,0 +1,48 @@
+// This is copyrighted software. More information is at the end of this file.
+#pragma once
+#include <chrono>
+
+/*
+ * Paces hugo_timewait() calls. Rather than sleeping for 1/n seconds from whenever we're called,
+ * we keep an absolute deadline on a monotonic clock and advance it by 1/n seconds each time. Time
+ * the game spends between calls (printing, drawing, running code) counts towards the wait, so
+ * games that animate with a timewait loop run at the rate they asked for instead of drifting
+ * slower.
+ */
+class FramePacer final
+{
+public:
+    // Wait until the next 1/n second deadline.
+    void wait(int n);
+
+    // Average of how late we woke up, in milliseconds, over the last few dozen waits.
+    double averageLateness() const
+    {
+        return lateness_ms_;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point deadline_;
+    int rate_ = 0;
+    double lateness_ms_ = 0;
+};
+
+/* Copyright (C) 2011-2019 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ */
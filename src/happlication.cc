@@ -5,18 +5,21 @@
 #include <QDesktopWidget>
 #include <QDialogButtonBox>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFileDialog>
 #include <QIcon>
 #include <QLabel>
 #include <QLayout>
 #include <QMenuBar>
 #include <QMessageBox>
+#include <QPointer>
 #include <QScreen>
 #include <QStatusBar>
 #include <QStyle>
 #include <QTextCodec>
 #include <utility>
 
+#include "displayqueue.h"
 #include "enginerunner.h"
 extern "C" {
 #include "heheader.h"
@@ -114,6 +117,9 @@ HApplication::HApplication(int& argc, char* argv[], const char* appName, const c
 
     frame_win_ = new HFrame(margin_widget_);
     margin_widget_->addWidget(frame_win_);
+
+    // Receives display commands from the engine thread.
+    new DisplayQueue(this);
     updateMargins(-1);
     main_win_->setCentralWidget(margin_widget_);
 
@@ -343,6 +349,7 @@ void HApplication::notifyPreferencesChange(const Settings& sett)
     HugoHandlers::calcFontDimensions();
 
     // The fonts might have changed.
+    hFrame->updateFontMetricsSet();
     hFrame->setFontType(currentfont);
     hMainWin->setScrollbackFont(sett.scrollback_font);
 
@@ -380,7 +387,25 @@ void HApplication::advanceEventLoop()
 
 void HApplication::terminateEngineThread()
 {
-    // FIXME This just doesn't work reliably. On Windows it just hangs.
+    engine_quit_requested_ = true;
+
+    // The thread deletes itself once it's finished. Until then, the engine may still need the GUI
+    // thread (and the thread's quit() is a queued call), so keep processing events while waiting.
+    QPointer<EngineThread> thread = hugo_thread_;
+    QElapsedTimer timer;
+    timer.start();
+    while (not thread.isNull() and not thread->isFinished() and not engine_waiting_for_input_
+           and timer.elapsed() < 2000) {
+        processEvents(QEventLoop::ExcludeUserInputEvents);
+        if (not thread.isNull()) {
+            thread->wait(10);
+        }
+    }
+    if (not thread.isNull() and not thread->isFinished() and not engine_waiting_for_input_) {
+        qWarning("Hugor: the engine didn't stop in time.");
+    }
+
+    // FIXME Forcibly terminating the thread just doesn't work reliably. On Windows it just hangs.
     /*
     fHugoThread->terminate();
     fHugoThread->wait(2000);
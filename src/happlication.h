@@ -3,6 +3,7 @@
 #include <QApplication>
 
 #include "settings.h"
+#include <atomic>
 #include <memory>
 
 class EngineRunner;
@@ -36,6 +37,12 @@ private:
     // Are we currently executing a game?
     bool is_game_running_ = false;
 
+    // Set when the engine thread should stop running the game at its next time slice.
+    std::atomic<bool> engine_quit_requested_{false};
+
+    // Set by the engine thread while it's blocked waiting for the player's input.
+    std::atomic<bool> engine_waiting_for_input_{false};
+
     // Filename of the game we're currently executing.
     QString gamefile_;
 
@@ -138,7 +145,20 @@ public:
         return is_desktop_gnome;
     }
 
+    // Asks the engine to stop running the game, and waits (up to a couple of seconds) until it has.
+    // The engine checks this between time slices (see hugo_timeslice()), so it won't see it while
+    // it's waiting for input; there's nothing left for it to finish then, so we don't wait.
     void terminateEngineThread();
+
+    bool engineQuitRequested() const
+    {
+        return engine_quit_requested_;
+    }
+
+    void setEngineWaitingForInput(bool waiting)
+    {
+        engine_waiting_for_input_ = waiting;
+    }
 };
 
 /* Copyright (C) 2011-2019 Nikos Chantziaras
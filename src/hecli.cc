@@ -0,0 +1,941 @@
+// This is copyrighted software. More information is at the end of this file.
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#include <conio.h>
+#include <io.h>
+#define isatty _isatty
+#define fileno _fileno
+#else
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+extern "C" {
+#include "heheader.h"
+}
+#include "framepacer.h"
+#include "hextrans.h"
+#include "hugodefs.h"
+#include "hugohandlers.h"
+#include "hugorfile.h"
+
+/*
+ * Text-only frontend for the Hugo engine. This implements the hugo_* display and input interface
+ * on top of stdin/stdout and is built as the "hugor-cli" target (see hugor-cli.pro.) There's no
+ * GUI thread here; the engine runs directly in main().
+ *
+ * The screen is character-based (FIXEDCHARWIDTH and FIXEDLINEHEIGHT are 1.) Output to the main
+ * window is written as a continuous stream. Output to other windows (status lines, etc.) is
+ * discarded, since there's no sensible way to present it in a stream of text.
+ */
+
+// Emit ANSI escape sequences for colors and font styles.
+static bool use_ansi = false;
+
+// Both stdin and stdout are terminals. If not, we assume automated play over pipes; no [MORE]
+// prompts, no delays and input lines get echoed to the output.
+static bool interactive = false;
+
+// Last SGR state we emitted, so that we only emit escape sequences when something changes.
+static int ansi_fg = -1;
+static int ansi_font = -1;
+
+// Report game routines that run for longer than this without waiting for input. 0 disables.
+static long watchdog_ms = 0;
+
+// When the engine last waited for input, and the elapsed time at which the watchdog reports the
+// running routine next.
+static std::chrono::steady_clock::time_point watchdog_start;
+static long watchdog_next_report = 0;
+
+// Current foreground color and font, as set by the engine.
+static int cur_fg = 16;
+static int cur_font = 0;
+
+// Unicode code points of Windows-1252 bytes 0x80 to 0x9F. Hugo games use Windows-1252.
+static const unsigned short cp1252_high[32] = {
+    0x20AC, 0xFFFD, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021, 0x02C6, 0x2030, 0x0160,
+    0x2039, 0x0152, 0xFFFD, 0x017D, 0xFFFD, 0xFFFD, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022,
+    0x2013, 0x2014, 0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0xFFFD, 0x017E, 0x0178};
+
+static void appendUtf8(std::string& dst, unsigned cp)
+{
+    if (cp < 0x80) {
+        dst += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        dst += static_cast<char>(0xC0 | (cp >> 6));
+        dst += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        dst += static_cast<char>(0xE0 | (cp >> 12));
+        dst += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        dst += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+// Converts a Windows-1252 string to UTF-8.
+static std::string toUtf8(const char* s)
+{
+    std::string ret;
+    for (; *s != '\0'; ++s) {
+        auto c = static_cast<unsigned char>(*s);
+        if (c >= 0x80 and c < 0xA0) {
+            appendUtf8(ret, cp1252_high[c - 0x80]);
+        } else {
+            appendUtf8(ret, c);
+        }
+    }
+    return ret;
+}
+
+// Converts a UTF-8 string to Windows-1252. Characters that can't be represented become '?'.
+static std::string fromUtf8(const std::string& s)
+{
+    std::string ret;
+    for (size_t i = 0; i < s.size();) {
+        auto c = static_cast<unsigned char>(s[i]);
+        unsigned cp;
+        int extra;
+        if (c < 0x80) {
+            cp = c;
+            extra = 0;
+        } else if ((c & 0xE0) == 0xC0) {
+            cp = c & 0x1F;
+            extra = 1;
+        } else if ((c & 0xF0) == 0xE0) {
+            cp = c & 0x0F;
+            extra = 2;
+        } else if ((c & 0xF8) == 0xF0) {
+            cp = c & 0x07;
+            extra = 3;
+        } else {
+            // Not UTF-8. Pass it through as-is.
+            ret += s[i++];
+            continue;
+        }
+        ++i;
+        for (; extra > 0 and i < s.size(); --extra, ++i) {
+            cp = (cp << 6) | (static_cast<unsigned char>(s[i]) & 0x3F);
+        }
+
+        if (cp < 0x80 or (cp >= 0xA0 and cp <= 0xFF)) {
+            ret += static_cast<char>(cp);
+            continue;
+        }
+        char out = '?';
+        for (int j = 0; j < 32; ++j) {
+            if (cp1252_high[j] == cp and cp != 0xFFFD) {
+                out = static_cast<char>(0x80 + j);
+                break;
+            }
+        }
+        ret += out;
+    }
+    return ret;
+}
+
+/* Helper routine. Converts a Hugo color to an ANSI SGR foreground color parameter.
+ */
+static int hugoColorToAnsi(int color)
+{
+    // Hugo orders the colors as black, blue, green, cyan, red, magenta, brown, white.
+    static const int ansi_order[8] = {0, 4, 2, 6, 1, 5, 3, 7};
+
+    color = static_cast<unsigned char>(color); // [-128..127] -> [0..255]
+    if (color <= static_cast<int>(HUGO_WHITE)) {
+        return 30 + ansi_order[color];
+    }
+    if (color <= static_cast<int>(HUGO_BRIGHT_WHITE)) {
+        return 90 + ansi_order[color - 8];
+    }
+    // The default colors (16 and up) and extended colors use the terminal's default.
+    return 39;
+}
+
+static void updateAnsiState()
+{
+    if (not use_ansi or (ansi_fg == cur_fg and ansi_font == cur_font)) {
+        return;
+    }
+    std::string seq = "\x1b[0";
+    if (cur_font & BOLD_FONT) {
+        seq += ";1";
+    }
+    if (cur_font & ITALIC_FONT) {
+        seq += ";3";
+    }
+    if (cur_font & UNDERLINE_FONT) {
+        seq += ";4";
+    }
+    seq += ';';
+    seq += std::to_string(hugoColorToAnsi(cur_fg));
+    seq += 'm';
+    std::fputs(seq.c_str(), stdout);
+    ansi_fg = cur_fg;
+    ansi_font = cur_font;
+}
+
+static void resetAnsiState()
+{
+    if (use_ansi and ansi_fg != -1) {
+        std::fputs("\x1b[0m", stdout);
+        ansi_fg = -1;
+        ansi_font = -1;
+    }
+}
+
+// Text written while inside a window doesn't go to the output stream.
+static bool outputEnabled()
+{
+    return not inwindow;
+}
+
+// The engine is about to run game code again after waiting; start timing it for the watchdog.
+static void restartWatchdog()
+{
+    watchdog_start = std::chrono::steady_clock::now();
+    watchdog_next_report = watchdog_ms;
+}
+
+static void queryScreenSize(int& cols, int& rows)
+{
+    cols = 80;
+    rows = 25;
+
+    if (const char* env = std::getenv("COLUMNS")) {
+        cols = std::atoi(env);
+    }
+    if (const char* env = std::getenv("LINES")) {
+        rows = std::atoi(env);
+    }
+#ifndef _WIN32
+    winsize ws{};
+    if (interactive and ioctl(fileno(stdout), TIOCGWINSZ, &ws) == 0 and ws.ws_col > 0) {
+        cols = ws.ws_col;
+        rows = ws.ws_row;
+    }
+#endif
+    if (cols < 20) {
+        cols = 80;
+    }
+    if (rows < 5) {
+        rows = 25;
+    }
+    // Without a terminal to page through, we make the screen tall enough that the engine never
+    // needs to show a [MORE] prompt.
+    if (not interactive) {
+        rows = 1000;
+    }
+}
+
+// Reads a line from stdin, without the line terminator. Exits on end of input. The line is
+// returned as-is; use fromUtf8() when it's meant for the game rather than for the file system.
+static std::string readInputLine()
+{
+    std::fflush(stdout);
+    std::string ret;
+    int c;
+    while ((c = std::fgetc(stdin)) != EOF and c != '\n') {
+        ret += static_cast<char>(c);
+    }
+    if (c == EOF and ret.empty()) {
+        resetAnsiState();
+        std::fflush(stdout);
+        std::exit(0);
+    }
+    if (not ret.empty() and ret.back() == '\r') {
+        ret.pop_back();
+    }
+    return ret;
+}
+
+void* hugo_blockalloc(long num)
+{
+    return new char[num];
+}
+
+void hugo_blockfree(void* block)
+{
+    delete[] static_cast<char*>(block);
+}
+
+/* The following supplied functions will work for Unix-style pathnames: */
+
+void hugo_splitpath(char* path, char* drive, char* dir, char* fname, char* ext)
+{
+    drive[0] = '\0';
+    dir[0] = '\0';
+    fname[0] = '\0';
+    ext[0] = '\0';
+
+    if (path[0] == '\0') {
+        return;
+    }
+
+    const char* base = std::strrchr(path, '/');
+    if (base != nullptr) {
+        std::strncpy(dir, path, base - path);
+        dir[base - path] = '\0';
+        ++base;
+    } else {
+        base = path;
+    }
+    std::strcpy(fname, base);
+    char* dot = std::strrchr(fname, '.');
+    if (dot != nullptr and dot != fname) {
+        std::strcpy(ext, dot + 1);
+        *dot = '\0';
+    }
+}
+
+void hugo_makepath(char* path, char* drive, char* dir, char* fname, char* ext)
+{
+    std::string result(drive);
+    result += dir;
+    if (not result.empty() and result.back() != '/') {
+        result += '/';
+    }
+    result += fname;
+    if (ext[0] != '\0') {
+        result += '.';
+        for (const char* c = ext; *c != '\0'; ++c) {
+            result += static_cast<char>(std::tolower(static_cast<unsigned char>(*c)));
+        }
+    }
+    std::strcpy(path, result.c_str());
+}
+
+/* hugo_getfilename
+
+    Loads the name of the filename to save or restore (as specified by
+    the argument <a>) into the line[] array.
+*/
+void hugo_getfilename(char* a, char* b)
+{
+    char prompt[MAXPATH + 32];
+    std::snprintf(prompt, sizeof(prompt), "Enter path and filename %s.", a);
+    AP(prompt);
+    std::snprintf(prompt, sizeof(prompt), "%c(Default is %s): \\;", NO_CONTROLCHAR, b);
+    AP(prompt);
+    Flushpbuffer();
+
+    const std::string& input = readInputLine();
+    if (input.empty()) {
+        std::strcpy(line, b);
+    } else {
+        std::strncpy(line, input.c_str(), MAXBUFFER);
+        line[MAXBUFFER] = '\0';
+    }
+    if (not interactive) {
+        std::printf("%s\n", toUtf8(line).c_str());
+    }
+    hugo_print(const_cast<char*>("\r"));
+    current_text_y += lineheight;
+}
+
+/* hugo_overwrite
+
+    Checks to see if the given filename already exists, and prompts to
+    replace it.  Returns true if file may be overwritten.
+*/
+int hugo_overwrite(char* f)
+{
+    FILE* handle = std::fopen(f, "rb");
+    if (handle == nullptr) {
+        return true;
+    }
+    std::fclose(handle);
+
+    char prompt[MAXPATH + 32];
+    std::snprintf(prompt, sizeof(prompt), "Overwrite existing \"%s\" (Y or N)? ", f);
+    hugo_print(prompt);
+    const std::string& input = readInputLine();
+    hugo_print(const_cast<char*>("\r"));
+    current_text_y += lineheight;
+    return not input.empty() and (input[0] == 'y' or input[0] == 'Y');
+}
+
+HUGO_FILE hugo_fopen(const char* path, const char* mode)
+{
+    auto handle = std::fopen(path, mode);
+    if (handle == nullptr) {
+        return nullptr;
+    }
+    return new HugorFile(handle);
+}
+
+HUGO_FILE hugo_fopendata(const char* path, const char* mode)
+{
+    return openDataFile(path, mode);
+}
+
+int hugo_fclosedata(HUGO_FILE file, int ok)
+{
+    if (not ok and file != nullptr and file->isInMemory()) {
+        file->discard();
+        delete file;
+        return 0;
+    }
+    return hugo_fclose(file);
+}
+
+int hugo_fclose(HUGO_FILE file)
+{
+    if (file == nullptr) {
+        return 0;
+    }
+    auto ret = file->close();
+    delete file;
+    return ret;
+}
+
+int hugo_fgetc(HUGO_FILE file)
+{
+    return file->getc();
+}
+
+int hugo_fseek(HUGO_FILE file, long offset, int whence)
+{
+    return file->seek(offset, whence);
+}
+
+long hugo_ftell(HUGO_FILE file)
+{
+    return file->tell();
+}
+
+size_t hugo_fread(void* ptr, size_t size, size_t nmemb, HUGO_FILE file)
+{
+    return file->read(ptr, size, nmemb);
+}
+
+char* hugo_fgets(char* s, int size, HUGO_FILE file)
+{
+    return std::fgets(s, size, file->get());
+}
+
+int hugo_fputc(int c, HUGO_FILE file)
+{
+    return file->putc(c);
+}
+
+int hugo_fputs(const char* s, HUGO_FILE file)
+{
+    return std::fputs(s, file->get());
+}
+
+int hugo_ferror(HUGO_FILE file)
+{
+    return file->error();
+}
+
+int hugo_fprintf(HUGO_FILE file, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    auto ret = std::vfprintf(file->get(), format, args);
+    va_end(args);
+    return ret;
+}
+
+/* hugo_closefiles
+
+    Closes all open files.
+*/
+void hugo_closefiles()
+{
+    delete game;
+    hugo_fclose(script);
+    delete io;
+    delete record;
+    flushDataFiles();
+}
+
+/* hugo_sendtoscrollback
+
+   There's no scrollback; the terminal has its own.
+*/
+void hugo_sendtoscrollback(char* /*a*/)
+{}
+
+int hugo_writetoscript(const char* s)
+{
+    return std::fputs(s, ::script->get()) < 0 ? -1 : 0;
+}
+
+/* hugo_getkey
+
+    Returns the next keystroke waiting in the keyboard buffer. The terminal is not put into raw
+    mode, so the arrow keys are not available, and a key only arrives once Enter is pressed. The
+    rest of that line is thrown away; otherwise its newline would be the next keystroke.
+*/
+int hugo_getkey(void)
+{
+    std::fflush(stdout);
+    int key = std::fgetc(stdin);
+    if (key == EOF) {
+        resetAnsiState();
+        std::fflush(stdout);
+        std::exit(0);
+    }
+    restartWatchdog();
+    if (key == '\n') {
+        return 13;
+    }
+    for (int c = key; c != '\n' and c != EOF;) {
+        c = std::fgetc(stdin);
+    }
+    return key;
+}
+
+/* hugo_getline
+
+    Gets a line of input from the keyboard, storing it in <buffer>.
+*/
+void hugo_getline(char* p)
+{
+    hugo_settextcolor(fcolor);
+    hugo_print(p);
+    hugo_settextcolor(icolor);
+
+    const std::string& input = fromUtf8(readInputLine());
+    restartWatchdog();
+    std::strncpy(::buffer, input.c_str(), MAXBUFFER);
+    ::buffer[MAXBUFFER] = '\0';
+
+    // When reading from a pipe, nothing echoes the input, so we do it ourselves in order to get a
+    // readable transcript.
+    if (not interactive and outputEnabled()) {
+        updateAnsiState();
+        std::fputs(toUtf8(::buffer).c_str(), stdout);
+        std::fputc('\n', stdout);
+    }
+    hugo_settextcolor(fcolor);
+    hugo_print(const_cast<char*>("\r"));
+    current_text_y += lineheight;
+
+    if (::script != nullptr) {
+        hugo_writetoscript(p);
+        hugo_writetoscript(::buffer);
+        hugo_writetoscript("\n");
+    }
+}
+
+/* hugo_waitforkey
+*/
+int hugo_waitforkey(void)
+{
+    return hugo_getkey();
+}
+
+/* hugo_iskeywaiting
+
+    Returns true if a keypress is waiting to be retrieved.
+*/
+int hugo_iskeywaiting(void)
+{
+    std::fflush(stdout);
+#ifdef _WIN32
+    return interactive ? _kbhit() : true;
+#else
+    pollfd pfd{fileno(stdin), POLLIN, 0};
+    restartWatchdog();
+    return poll(&pfd, 1, 0) > 0;
+#endif
+}
+
+/* hugo_timewait
+
+    Waits for 1/n seconds.  Returns false if waiting is unsupported.
+*/
+int hugo_timewait(int n)
+{
+    std::fflush(stdout);
+    // Don't slow down automated play.
+    if (interactive and n > 0) {
+        static FramePacer pacer;
+        pacer.wait(n);
+    }
+    restartWatchdog();
+    return true;
+}
+
+/* hugo_timeslice
+
+    Called by RunRoutine() every <timeslice_statements> statements while running the routine at
+    <addr>. Shows the text printed so far and reports routines that run for longer than the
+    watchdog limit. There's nothing that asks the game to stop, so this always returns false.
+*/
+int hugo_timeslice(long addr)
+{
+    std::fflush(stdout);
+    if (watchdog_ms > 0) {
+        const long elapsed = static_cast<long>(
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()
+                                                                  - watchdog_start)
+                .count());
+        if (elapsed >= watchdog_next_report) {
+            std::fprintf(stderr, "hugor-cli: routine $%06lX has been running for %ld ms.\n", addr,
+                         elapsed);
+            watchdog_next_report = elapsed + watchdog_ms;
+        }
+    }
+    return false;
+}
+
+/* Does whatever has to be done to initially set up the display.
+ */
+void hugo_init_screen(void)
+{
+    restartWatchdog();
+}
+
+/* Returns true if the current display is capable of graphics display.
+ */
+int hugo_hasgraphics(void)
+{
+    return false;
+}
+
+void hugo_setgametitle(char* t)
+{
+    if (use_ansi and interactive) {
+        std::printf("\x1b]0;%s\x07", toUtf8(t).c_str());
+    }
+}
+
+/* Does whatever has to be done to clean up the display pre-termination.
+ */
+void hugo_cleanup_screen(void)
+{
+    resetAnsiState();
+    std::fflush(stdout);
+}
+
+/* Clears everything on the screen, moving the cursor to the top-left
+ * corner of the screen. We don't actually clear anything, since the output is a stream.
+ */
+void hugo_clearfullscreen(void)
+{
+    currentpos = 0;
+    currentline = 1;
+    TB_Clear(0, 0, SCREENWIDTH, SCREENHEIGHT);
+}
+
+/* Clears the currently defined window, moving the cursor to the top-left
+ * corner of the window.
+ */
+void hugo_clearwindow(void)
+{
+    currentpos = 0;
+    currentline = 1;
+    TB_Clear(physical_windowleft, physical_windowtop, physical_windowright, physical_windowbottom);
+}
+
+/* This function does whatever is necessary to set the system up for a standard text display.
+ */
+void hugo_settextmode(void)
+{
+    FIXEDCHARWIDTH = 1;
+    FIXEDLINEHEIGHT = 1;
+    ::charwidth = 1;
+    lineheight = 1;
+    queryScreenSize(SCREENWIDTH, SCREENHEIGHT);
+
+    /* Must be set: */
+    hugo_settextwindow(1, 1, SCREENWIDTH, SCREENHEIGHT);
+}
+
+/* Create a text window from (column, row) character-coordinates (left, top) to (right, bottom).
+ */
+void hugo_settextwindow(int left, int top, int right, int bottom)
+{
+    /* Must be set: */
+    physical_windowleft = (left - 1) * FIXEDCHARWIDTH;
+    physical_windowtop = (top - 1) * FIXEDLINEHEIGHT;
+    physical_windowright = right * FIXEDCHARWIDTH - 1;
+    physical_windowbottom = bottom * FIXEDLINEHEIGHT - 1;
+    physical_windowwidth = physical_windowright - physical_windowleft + 1;
+    physical_windowheight = physical_windowbottom - physical_windowtop + 1;
+}
+
+/* The top-left corner of the current active window is (1, 1).
+ */
+void hugo_settextpos(int x, int y)
+{
+    // Must be set:
+    currentline = y;
+    currentpos = (x - 1) * ::charwidth; // Note:  zero-based
+
+    // current_text_x/row are calculated assuming that the
+    // character position (1, 1) is the pixel position (0, 0)
+    current_text_x = physical_windowleft + currentpos;
+    current_text_y = physical_windowtop + (y - 1) * lineheight;
+}
+
+/* PRINTFATALERROR may be #defined in heheader.h.
+ */
+void printFatalError(char* a)
+{
+    resetAnsiState();
+    std::fflush(stdout);
+    std::fputs(toUtf8(a).c_str(), stderr);
+}
+
+/* Output <a>, taking into account the current window.
+ */
+void hugo_print(char* a)
+{
+    std::string out;
+
+    for (const char* c = a; *c != '\0'; ++c) {
+        // If we've passed the bottom of the window, align to the bottom edge.
+        if (current_text_y > physical_windowbottom - lineheight) {
+            current_text_y = physical_windowbottom - lineheight;
+            TB_Scroll();
+        }
+
+        switch (*c) {
+        case '\n':
+            out += '\n';
+            current_text_y += lineheight;
+            break;
+
+        case '\r':
+            current_text_x = physical_windowleft;
+            break;
+
+        default:
+            if (static_cast<unsigned char>(*c) >= ' ') {
+                const char ch[2] = {*c, '\0'};
+                out += toUtf8(ch);
+                current_text_x += FIXEDCHARWIDTH;
+            }
+        }
+    }
+
+    if (outputEnabled() and not out.empty()) {
+        updateAnsiState();
+        std::fputs(out.c_str(), stdout);
+    }
+}
+
+/* Scroll the current text window up one line. For us, that's just a newline in the stream.
+ */
+void hugo_scrollwindowup()
+{
+    if (outputEnabled()) {
+        std::fputc('\n', stdout);
+    }
+    TB_Scroll();
+}
+
+/* The <f> argument is a mask containing any or none of:
+   BOLD_FONT, UNDERLINE_FONT, ITALIC_FONT, PROP_FONT.
+*/
+void hugo_font(int f)
+{
+    cur_font = f;
+}
+
+void hugo_settextcolor(int c)
+{
+    cur_fg = c;
+}
+
+void hugo_setbackcolor(int /*c*/)
+{
+    // Background colors are left to the terminal. Hugo's default background is blue, which would
+    // look out of place in most terminals.
+}
+
+/* CHARACTER AND TEXT MEASUREMENT
+
+    All characters are one cell wide, regardless of the current font.
+*/
+int hugo_charwidth(char a)
+{
+    if (a == FORCED_SPACE) {
+        a = ' ';
+    }
+    if (static_cast<unsigned char>(a) < ' ') {
+        return 0;
+    }
+    return FIXEDCHARWIDTH;
+}
+
+int hugo_textwidth(char* a)
+{
+    return hugo_strlen(a) * FIXEDCHARWIDTH;
+}
+
+int hugo_strlen(char* a)
+{
+    size_t len = 0;
+    size_t slen = std::strlen(a);
+
+    for (size_t i = 0; i < slen; ++i) {
+        if (a[i] == COLOR_CHANGE) {
+            i += 2;
+        } else if (a[i] == FONT_CHANGE) {
+            ++i;
+        } else {
+            ++len;
+        }
+    }
+    return len;
+}
+
+int hugo_displaypicture(HUGO_FILE infile, long /*len*/)
+{
+    delete infile;
+    return true;
+}
+
+int hugo_playmusic(HUGO_FILE infile, long len, char loop_flag)
+{
+    int result;
+    HugoHandlers::playmusic(infile, len, loop_flag, &result);
+    delete infile;
+    return result;
+}
+
+void hugo_musicvolume(int vol)
+{
+    HugoHandlers::musicvolume(vol);
+}
+
+void hugo_stopmusic(void)
+{
+    HugoHandlers::stopmusic();
+}
+
+int hugo_playsample(HUGO_FILE infile, long len, char loop_flag)
+{
+    int result;
+    HugoHandlers::playsample(infile, len, loop_flag, &result);
+    delete infile;
+    return result;
+}
+
+void hugo_samplevolume(int vol)
+{
+    HugoHandlers::samplevolume(vol);
+}
+
+void hugo_stopsample(void)
+{
+    HugoHandlers::stopsample();
+}
+
+int hugo_hasvideo(void)
+{
+    return false;
+}
+
+void hugo_stopvideo(void)
+{}
+
+int hugo_playvideo(HUGO_FILE infile, long, char, char, int)
+{
+    delete infile;
+    return true;
+}
+
+static void printUsage(const char* argv0)
+{
+    std::printf("Usage: %s [--color | --no-color] [--verify] [--memoize-scope] [--timeslice N]\n"
+                "       %*s [--watchdog MS] gamefile[.hex]\n"
+                "       %s --translate output.c gamefile[.hex]\n",
+                argv0, static_cast<int>(std::strlen(argv0)), "", argv0);
+}
+
+// Loads the game the same way he_main() does, but instead of running it, translates its routines
+// to C.
+static int translate(char* argv0, char* gameFile, const char* outFile)
+{
+    char* engineArgv[] = {argv0, gameFile, nullptr};
+    ParseCommandLine(2, engineArgv);
+    hugo_init_screen();
+    SetupDisplay();
+    LoadGame();
+    int ret = translateGame(outFile) ? 0 : 1;
+    hugo_blockfree(mem);
+    mem = nullptr;
+    hugo_closefiles();
+    return ret;
+}
+
+int main(int argc, char* argv[])
+{
+    interactive = isatty(fileno(stdin)) and isatty(fileno(stdout));
+    use_ansi = isatty(fileno(stdout)) and std::getenv("NO_COLOR") == nullptr;
+
+    char* gameFile = nullptr;
+    const char* translateFile = nullptr;
+    timeslice_statements = 100000;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--translate") == 0 and i + 1 < argc) {
+            translateFile = argv[++i];
+        } else if (std::strcmp(argv[i], "--verify") == 0) {
+            verify_code = true;
+        } else if (std::strcmp(argv[i], "--memoize-scope") == 0) {
+            memoize_available = true;
+        } else if (std::strcmp(argv[i], "--timeslice") == 0 and i + 1 < argc) {
+            timeslice_statements = std::max(0L, std::atol(argv[++i]));
+        } else if (std::strcmp(argv[i], "--watchdog") == 0 and i + 1 < argc) {
+            watchdog_ms = std::max(0L, std::atol(argv[++i]));
+        } else if (std::strcmp(argv[i], "--color") == 0) {
+            use_ansi = true;
+        } else if (std::strcmp(argv[i], "--no-color") == 0) {
+            use_ansi = false;
+        } else if (std::strcmp(argv[i], "--help") == 0 or std::strcmp(argv[i], "-h") == 0) {
+            printUsage(argv[0]);
+            return 0;
+        } else if (gameFile == nullptr) {
+            gameFile = argv[i];
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (gameFile == nullptr) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (translateFile != nullptr) {
+        return translate(argv[0], gameFile, translateFile);
+    }
+
+    initSoundEngine();
+    char* engineArgv[] = {argv[0], gameFile, nullptr};
+    int ret = he_main(2, engineArgv);
+    closeSoundEngine();
+    return ret;
+}
+
+/* Copyright (C) 2011-2019 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ */
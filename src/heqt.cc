@@ -1,5 +1,6 @@
 // This is copyrighted software. More information is at the end of this file.
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QFileInfo>
 #include <QMutexLocker>
 #include <QTextCodec>
@@ -8,7 +9,9 @@
 #include <QTimer>
 #include <cstdarg>
 
+#include "displayqueue.h"
 #include "extcolors.h"
+#include "framepacer.h"
 #include "happlication.h"
 extern "C" {
 #include "heheader.h"
@@ -38,6 +41,29 @@ static QString* scriptBuffer = nullptr;
 // Buffer for the scrollback. We flush it when needed.
 static QByteArray* scrollbackBuffer = nullptr;
 
+// Statements the engine runs between calls to hugo_timeslice().
+static constexpr long TIMESLICE_STATEMENTS = 100000;
+
+// Time since the engine last waited for input.
+static QElapsedTimer* watchdogTimer = nullptr;
+
+// Elapsed time at which the watchdog reports the running routine next.
+static qint64 watchdogNextReport = 0;
+
+// Font type last set by the engine. The GUI thread only switches fonts when it gets to the queued
+// command, but the engine has to measure text in the new font right away.
+static int engineFont = PROP_FONT;
+
+// Keeps hugo_timewait() loops at the rate the game asked for.
+static FramePacer framePacer;
+static bool framePacerLateReported = false;
+
+static void restartWatchdog()
+{
+    watchdogTimer->start();
+    watchdogNextReport = hApp->settings().watchdog_ms;
+}
+
 // Virtual control file for the Hugor handshake.
 HugorFile& checkFile()
 {
@@ -190,10 +216,42 @@ static void flushScriptBuffer()
 
 static void flushScrollbackBuffer()
 {
-    runInMainThread([] { hMainWin->appendToScrollback(*scrollbackBuffer); });
+    hDisplayQueue->pushBytes(DisplayCommand::Type::AppendToScrollback, *scrollbackBuffer);
     scrollbackBuffer->clear();
 }
 
+// The engine thread's reference to the metrics of the 'hugoFont' font type. We only need to go
+// through the atomic shared_ptr functions when HFrame has published a new set.
+static const FontMetricsSnapshot& engineFontMetrics(const int hugoFont)
+{
+    static std::shared_ptr<const FontMetricsSet> metrics;
+    static int generation = -1;
+
+    const int current_generation = hFrame->fontMetricsGeneration();
+    if (generation != current_generation) {
+        metrics = hFrame->fontMetricsSet();
+        generation = current_generation;
+    }
+    return *(*metrics)[hugoFont & 15];
+}
+
+// If the text position has passed the bottom of the window, scrolls the window so that the text
+// position is aligned to its bottom edge.
+static void scrollToTextPos()
+{
+    if (current_text_y <= physical_windowbottom - lineheight) {
+        return;
+    }
+    const int temp_lh = lineheight;
+    lineheight = current_text_y - physical_windowbottom + lineheight;
+    current_text_y -= lineheight;
+    if (inwindow) {
+        --lineheight;
+    }
+    hugo_scrollwindowup();
+    lineheight = temp_lh;
+}
+
 void* hugo_blockalloc(long num)
 {
     return new char[num];
@@ -272,7 +330,7 @@ void hugo_makepath(char* path, char* drive, char* dir, char* fname, char* ext)
 */
 void hugo_getfilename(char* a, char* b)
 {
-    runInMainThread([a, b] { HugoHandlers::getfilename(a, b); });
+    runInMainThreadAfterQueue([a, b] { HugoHandlers::getfilename(a, b); });
 }
 
 /* hugo_overwrite
@@ -309,6 +367,25 @@ HUGO_FILE hugo_fopen(const char* path, const char* mode)
     return new HugorFile(handle);
 }
 
+HUGO_FILE hugo_fopendata(const char* path, const char* mode)
+{
+    // The virtual files are opened with "readfile"/"writefile" too.
+    if (QString(path).endsWith(CHECK_FNAME) or QString(path).endsWith(CONTROL_FNAME)) {
+        return hugo_fopen(path, mode);
+    }
+    return openDataFile(path, mode);
+}
+
+int hugo_fclosedata(HUGO_FILE file, int ok)
+{
+    if (not ok and file != nullptr and file->isInMemory()) {
+        file->discard();
+        delete file;
+        return 0;
+    }
+    return hugo_fclose(file);
+}
+
 int hugo_fclose(HUGO_FILE file)
 {
     if (file == nullptr or file == &checkFile()) {
@@ -339,7 +416,7 @@ int hugo_fgetc(HUGO_FILE file)
         }
         return EOF;
     }
-    return std::fgetc(file->get());
+    return file->getc();
 }
 
 int hugo_fseek(HUGO_FILE file, long offset, int whence)
@@ -348,7 +425,7 @@ int hugo_fseek(HUGO_FILE file, long offset, int whence)
         qDebug() << Q_FUNC_INFO;
         return 0;
     }
-    return std::fseek(file->get(), offset, whence);
+    return file->seek(offset, whence);
 }
 
 long hugo_ftell(HUGO_FILE file)
@@ -356,7 +433,7 @@ long hugo_ftell(HUGO_FILE file)
     if (file == &ctrlFile()) {
         qDebug() << Q_FUNC_INFO;
     }
-    return std::ftell(file->get());
+    return file->tell();
 }
 
 size_t hugo_fread(void* ptr, size_t size, size_t nmemb, HUGO_FILE file)
@@ -365,7 +442,7 @@ size_t hugo_fread(void* ptr, size_t size, size_t nmemb, HUGO_FILE file)
         qDebug() << Q_FUNC_INFO;
         return 0;
     }
-    return std::fread(ptr, size, nmemb, file->get());
+    return file->read(ptr, size, nmemb);
 }
 
 char* hugo_fgets(char* s, int size, HUGO_FILE file)
@@ -383,7 +460,7 @@ int hugo_fputc(int c, HUGO_FILE file)
         opcodeParser().pushByte(c);
         return c;
     }
-    return std::fputc(c, file->get());
+    return file->putc(c);
 }
 
 int hugo_fputs(const char* s, HUGO_FILE file)
@@ -401,7 +478,7 @@ int hugo_ferror(HUGO_FILE file)
         qDebug() << Q_FUNC_INFO;
         return 0;
     }
-    return std::ferror(file->get());
+    return file->error();
 }
 
 int hugo_fprintf(HUGO_FILE file, const char* format, ...)
@@ -429,6 +506,7 @@ void hugo_closefiles()
     hugo_fclose(script);
     delete io;
     delete record;
+    flushDataFiles();
 }
 
 /* hugo_sendtoscrollback
@@ -464,21 +542,18 @@ int hugo_getkey(void)
     }
     flushScrollbackBuffer();
 
-    QMutexLocker mLocker(waiterMutex);
-    if (not hugo_iskeywaiting()) {
-        hFrame->keypressAvailableWaitCond.wait(waiterMutex);
-    }
-    mLocker.unlock();
-
-    int key = hFrame->getNextKey();
-    if (key == 0) {
+    hApp->setEngineWaitingForInput(true);
+    hFrame->waitForInputEvent();
+    hApp->setEngineWaitingForInput(false);
+    const HFrame::InputEvent& event = hFrame->takeInputEvent();
+    restartWatchdog();
+    if (event.key == 0) {
         // It's a mouse click.
-        const QPoint& pos = hFrame->getNextClick();
-        display_pointer_x = (pos.x() - physical_windowleft) / FIXEDCHARWIDTH + 1;
-        display_pointer_y = (pos.y() - physical_windowtop) / FIXEDLINEHEIGHT + 1;
+        display_pointer_x = (event.pos.x() - physical_windowleft) / FIXEDCHARWIDTH + 1;
+        display_pointer_y = (event.pos.y() - physical_windowtop) / FIXEDLINEHEIGHT + 1;
         return 1;
     }
-    return key;
+    return event.key;
 }
 
 /* hugo_getline
@@ -494,11 +569,26 @@ void hugo_getline(char* p)
     hugo_sendtoscrollback(p);
     flushScrollbackBuffer();
 
+    // Print the prompt in normal text colors, then switch to the input color.
+    hugo_settextcolor(fcolor);
+    hugo_setbackcolor(bgcolor);
+    hugo_print(p);
+    hugo_settextcolor(icolor);
+    const int x = current_text_x;
+    const int y = current_text_y;
+
     QMutexLocker mLocker(waiterMutex);
-    runInMainThread([p] { HugoHandlers::startGetline(p); });
+    runInMainThreadAfterQueue([x, y] { HugoHandlers::startGetline(x, y); });
+    hApp->setEngineWaitingForInput(true);
     hFrame->inputLineWaitCond.wait(waiterMutex);
+    hApp->setEngineWaitingForInput(false);
     hFrame->getInput(::buffer, MAXBUFFER);
     runInMainThread([] { HugoHandlers::endGetline(); });
+    mLocker.unlock();
+    char crlf[] = "\r\n";
+    hugo_print(crlf);
+    hDisplayQueue->push(DisplayCommand::Type::UpdateScreen);
+    restartWatchdog();
 
     // Also copy the input to the script file (if there is one) and the scrollback.
     if (script != nullptr) {
@@ -532,8 +622,9 @@ int hugo_waitforkey(void)
 int hugo_iskeywaiting(void)
 {
     // qDebug(Q_FUNC_INFO);
-    runInMainThread([] { hFrame->updateGameScreen(false); });
-    return hFrame->hasKeyInQueue();
+    // Games that poll for keys in real time aren't stuck.
+    restartWatchdog();
+    return hFrame->hasInputEvent();
 }
 
 /* hugo_timewait
@@ -544,12 +635,41 @@ int hugo_timewait(int n)
 {
     // qDebug() << Q_FUNC_INFO;
     if (hApp->gameRunning() and n > 0) {
-        QThread::msleep(1000 / n);
-        runInMainThread([] { hFrame->updateGameScreen(false); });
+        framePacer.wait(n);
+        if (not framePacerLateReported and framePacer.averageLateness() > 1.0) {
+            qWarning("Hugor: timewait is running %.2f ms late on average.",
+                     framePacer.averageLateness());
+            framePacerLateReported = true;
+        }
     }
+    restartWatchdog();
     return true;
 }
 
+/* hugo_timeslice
+
+    Called by RunRoutine() every <timeslice_statements> statements while
+    running the routine at <addr>.  Reports routines that run for longer
+    than the watchdog limit.  (The text printed so far shows up on its
+    own; HFrame updates the screen from a timer.)  Returns true if the
+    game should stop.
+*/
+int hugo_timeslice(long addr)
+{
+    if (hApp->engineQuitRequested()) {
+        return true;
+    }
+
+    const qint64 elapsed = watchdogTimer->elapsed();
+    const int watchdogMs = hApp->settings().watchdog_ms;
+    if (watchdogMs > 0 and elapsed >= watchdogNextReport) {
+        qWarning("Hugor watchdog: routine $%06lX has been running for %lld ms.", addr,
+                 static_cast<long long>(elapsed));
+        watchdogNextReport = elapsed + watchdogMs;
+    }
+    return false;
+}
+
 /* DISPLAY CONTROL:
 
    Briefly, the variables required to interface with the engine's output
@@ -589,6 +709,9 @@ void hugo_init_screen(void)
     waiterMutex = new QMutex;
     scriptBuffer = new QString;
     scrollbackBuffer = new QByteArray;
+    watchdogTimer = new QElapsedTimer;
+    restartWatchdog();
+    timeslice_statements = TIMESLICE_STATEMENTS;
 }
 
 /* Returns true if the current display is capable of graphics display;
@@ -604,7 +727,7 @@ int hugo_hasgraphics(void)
 
 void hugo_setgametitle(char* t)
 {
-    runInMainThread([t] { hMainWin->setWindowTitle(QLatin1String(t)); });
+    hDisplayQueue->pushText(DisplayCommand::Type::SetWindowTitle, QLatin1String(t));
 }
 
 /* Does whatever has to be done to clean up the display pre-termination.
@@ -621,7 +744,7 @@ void hugo_cleanup_screen(void)
  */
 void hugo_clearfullscreen(void)
 {
-    runInMainThread([] { HugoHandlers::clearfullscreen(); });
+    hDisplayQueue->push(DisplayCommand::Type::ClearRegion, 0, 0, 0, 0);
     currentpos = 0;
     currentline = 1;
     TB_Clear(0, 0, screenwidth, screenheight);
@@ -632,7 +755,9 @@ void hugo_clearfullscreen(void)
  */
 void hugo_clearwindow(void)
 {
-    runInMainThread([] { HugoHandlers::clearwindow(); });
+    hDisplayQueue->push(DisplayCommand::Type::SetBgColor, bgcolor);
+    hDisplayQueue->push(DisplayCommand::Type::ClearRegion, physical_windowleft, physical_windowtop,
+                        physical_windowright, physical_windowbottom);
     currentpos = 0;
     currentline = 1;
     TB_Clear(physical_windowleft, physical_windowtop, physical_windowright, physical_windowbottom);
@@ -671,7 +796,7 @@ void hugo_clearwindow(void)
 */
 void hugo_settextmode(void)
 {
-    runInMainThread([] { HugoHandlers::settextmode(); });
+    runInMainThreadAfterQueue([] { HugoHandlers::settextmode(); });
 }
 
 /* Once again, the arguments for the window are passed using character
@@ -691,8 +816,11 @@ void hugo_settextmode(void)
 */
 void hugo_settextwindow(int left, int top, int right, int bottom)
 {
-    runInMainThread(
-        [left, top, right, bottom] { HugoHandlers::settextwindow(left, top, right, bottom); });
+    HugoHandlers::calcTextWindow(left, top, right, bottom);
+    engineFont = currentfont;
+    hDisplayQueue->push(DisplayCommand::Type::SetFgColor, fcolor);
+    hDisplayQueue->push(DisplayCommand::Type::SetBgColor, bgcolor);
+    hDisplayQueue->push(DisplayCommand::Type::SetFontType, currentfont);
 }
 
 /* The top-left corner of the current active window is (1, 1).
@@ -729,7 +857,8 @@ void hugo_settextpos(int x, int y)
  */
 void printFatalError(char* a)
 {
-    runInMainThread([a] { HugoHandlers::printFatalError(a); });
+    hugo_print(a);
+    runInMainThreadAfterQueue([] { hFrame->updateGameScreen(false); });
 }
 
 /* Essentially the same as printf() without formatting, since printf()
@@ -746,17 +875,45 @@ void printFatalError(char* a)
 */
 void hugo_print(char* a)
 {
-    runInMainThread([a] { HugoHandlers::print(a); });
+    const uint len = qstrlen(a);
+    QByteArray text;
+
+    for (uint i = 0; i < len; ++i) {
+        // If we've passed the bottom of the window, align to the bottom edge.
+        scrollToTextPos();
+
+        switch (a[i]) {
+        case '\n':
+            hDisplayQueue->push(DisplayCommand::Type::FlushText);
+            current_text_y += lineheight;
+            // last_was_italic = false;
+            break;
+
+        case '\r':
+            hDisplayQueue->push(DisplayCommand::Type::FlushText);
+            current_text_x = physical_windowleft;
+            // last_was_italic = false;
+            break;
+
+        default:
+            text += a[i];
+        }
+    }
+
+    hDisplayQueue->pushText(DisplayCommand::Type::PrintText, hApp->hugoCodec()->toUnicode(text),
+                            current_text_x, current_text_y);
+    current_text_x += engineFontMetrics(engineFont).textWidth(text.constData(), text.size());
+
+    // Check again after printing.
+    scrollToTextPos();
 }
 
 /* Scroll the current text window up one line.
  */
 void hugo_scrollwindowup()
 {
-    runInMainThread([] {
-        hFrame->scrollUp(physical_windowleft, physical_windowtop, physical_windowright,
-                         physical_windowbottom, lineheight);
-    });
+    hDisplayQueue->push(DisplayCommand::Type::ScrollUp, physical_windowleft, physical_windowtop,
+                        physical_windowright, physical_windowbottom, lineheight);
     TB_Scroll();
 }
 
@@ -768,17 +925,20 @@ void hugo_scrollwindowup()
 */
 void hugo_font(int f)
 {
-    runInMainThread([f] { HugoHandlers::font(f); });
+    engineFont = f;
+    hDisplayQueue->push(DisplayCommand::Type::SetFontType, f);
+    ::charwidth = engineFontMetrics(f).averageCharWidth();
+    lineheight = engineFontMetrics(f).lineSpacing();
 }
 
 void hugo_settextcolor(int c)
 {
-    runInMainThread([c] { HugoHandlers::settextcolor(c); });
+    hDisplayQueue->push(DisplayCommand::Type::SetFgColor, c);
 }
 
 void hugo_setbackcolor(int c)
 {
-    runInMainThread([c] { HugoHandlers::setbackcolor(c); });
+    hDisplayQueue->push(DisplayCommand::Type::SetBgColor, c);
 }
 
 /* CHARACTER AND TEXT MEASUREMENT
@@ -795,15 +955,15 @@ void hugo_setbackcolor(int c)
 */
 int hugo_charwidth(char a)
 {
+    if (currentfont & PROP_FONT) {
+        return engineFontMetrics(engineFont).charWidth(a);
+    }
     if (a == FORCED_SPACE) {
         a = ' ';
     }
     if (static_cast<unsigned char>(a) < ' ') {
         return 0;
     }
-    if (currentfont & PROP_FONT) {
-        return hFrame->currentFontMetrics().width(hApp->hugoCodec()->toUnicode(&a, 1));
-    }
     return FIXEDCHARWIDTH;
 }
 
@@ -814,21 +974,7 @@ int hugo_textwidth(char* a)
     if (not(currentfont & PROP_FONT)) {
         return hugo_strlen(a) * FIXEDCHARWIDTH;
     }
-
-    size_t slen = qstrlen(a);
-    QString str;
-
-    // Construct a string that contains only printable characters.
-    for (size_t i = 0; i < slen; ++i) {
-        if (a[i] == COLOR_CHANGE) {
-            i += 2;
-        } else if (a[i] == FONT_CHANGE) {
-            ++i;
-        } else {
-            str += hApp->hugoCodec()->toUnicode(a + i, 1);
-        }
-    }
-    return hFrame->currentFontMetrics().width(str);
+    return engineFontMetrics(engineFont).textWidth(a, qstrlen(a));
 }
 
 int hugo_strlen(char* a)
@@ -851,7 +997,8 @@ int hugo_strlen(char* a)
 int hugo_displaypicture(HUGO_FILE infile, long len)
 {
     int result;
-    runInMainThread([infile, len, &result] { HugoHandlers::displaypicture(infile, len, &result); });
+    runInMainThreadAfterQueue(
+        [infile, len, &result] { HugoHandlers::displaypicture(infile, len, &result); });
     delete infile;
     return result;
 }
@@ -859,7 +1006,7 @@ int hugo_displaypicture(HUGO_FILE infile, long len)
 int hugo_playmusic(HUGO_FILE infile, long len, char loop_flag)
 {
     int result;
-    runInMainThread([infile, len, loop_flag, &result] {
+    runInMainThreadAfterQueue([infile, len, loop_flag, &result] {
         HugoHandlers::playmusic(infile, len, loop_flag, &result);
     });
     delete infile;
@@ -868,18 +1015,18 @@ int hugo_playmusic(HUGO_FILE infile, long len, char loop_flag)
 
 void hugo_musicvolume(int vol)
 {
-    runInMainThread([vol] { HugoHandlers::musicvolume(vol); });
+    runInMainThreadAfterQueue([vol] { HugoHandlers::musicvolume(vol); });
 }
 
 void hugo_stopmusic(void)
 {
-    runInMainThread([] { HugoHandlers::stopmusic(); });
+    runInMainThreadAfterQueue([] { HugoHandlers::stopmusic(); });
 }
 
 int hugo_playsample(HUGO_FILE infile, long len, char loop_flag)
 {
     int result;
-    runInMainThread([infile, len, loop_flag, &result] {
+    runInMainThreadAfterQueue([infile, len, loop_flag, &result] {
         HugoHandlers::playsample(infile, len, loop_flag, &result);
     });
     delete infile;
@@ -888,12 +1035,12 @@ int hugo_playsample(HUGO_FILE infile, long len, char loop_flag)
 
 void hugo_samplevolume(int vol)
 {
-    runInMainThread([vol] { HugoHandlers::samplevolume(vol); });
+    runInMainThreadAfterQueue([vol] { HugoHandlers::samplevolume(vol); });
 }
 
 void hugo_stopsample(void)
 {
-    runInMainThread([] { HugoHandlers::stopsample(); });
+    runInMainThreadAfterQueue([] { HugoHandlers::stopsample(); });
 }
 
 #ifdef DISABLE_VIDEO
@@ -936,13 +1083,13 @@ int hugo_hasvideo(void)
 
 void hugo_stopvideo(void)
 {
-    runInMainThread([] { HugoHandlers::stopvideo(); });
+    runInMainThreadAfterQueue([] { HugoHandlers::stopvideo(); });
 }
 
 int hugo_playvideo(HUGO_FILE infile, long len, char loop, char bg, int vol)
 {
     int result;
-    runInMainThread([infile, len, loop, bg, vol, &result] {
+    runInMainThreadAfterQueue([infile, len, loop, bg, vol, &result] {
         HugoHandlers::playvideo(infile, len, loop, bg, vol, &result);
     });
     delete infile;
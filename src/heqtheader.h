@@ -40,8 +40,11 @@ typedef struct HugorFile HugorFile;
 #define USE_TEXTBUFFER
 #define USE_SMARTFORMATTING
 #define SCROLLBACK_DEFINED
+#define TIMESLICE_DEFINED
 #define CUSTOM_SCRIPT_WRITE
 #define HUGO_FOPEN hugo_fopen
+#define HUGO_FOPEN_DATA hugo_fopendata
+#define HUGO_FCLOSE_DATA hugo_fclosedata
 #define HUGO_FCLOSE
 #define HUGO_FSEEK hugo_fseek
 
@@ -60,6 +63,8 @@ int hugo_playvideo(HUGO_FILE infile, long len, char loop, char bg, int vol);
 void hugo_stopvideo(void);
 int hugo_writetoscript(const char* s);
 HUGO_FILE hugo_fopen(const char* path, const char* mode);
+HUGO_FILE hugo_fopendata(const char* path, const char* mode);
+int hugo_fclosedata(HUGO_FILE file, int ok);
 int hugo_fclose(HUGO_FILE file);
 int hugo_fgetc(HUGO_FILE file);
 int hugo_fseek(HUGO_FILE file, long offset, int whence);
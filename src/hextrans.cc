@@ -0,0 +1,1068 @@
+// This is copyrighted software. More information is at the end of this file.
+#include "hextrans.h"
+
+#include <cstdio>
+#include <iterator>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "heheader.h"
+}
+
+/*
+ * Ahead-of-time translation of Hugo routines to C.
+ *
+ * Each statement of a routine becomes a labeled block of C code. Control flow (conditionals,
+ * loops, jumps, labels, 'break' and 'return') is translated to gotos, and assignments and
+ * conditions made of plain variables and constants are evaluated natively. Statements we can't
+ * evaluate natively are handed to the same engine functions RunRoutine() calls for them, with
+ * codeptr pointing at the statement; execution then continues at whatever label codeptr ends up
+ * on. Anything else hands the rest of the routine back to the interpreter (ResumeRoutine().)
+ *
+ * The generated code keeps the code_block[] stack the same way RunRoutine() does, so translated
+ * and interpreted code can be mixed freely.
+ */
+
+// How a statement was translated, for the coverage report.
+enum class Kind
+{
+    Native,      // Runs without the interpreter.
+    Delegated,   // Calls the engine function RunRoutine() would call for it.
+    Interpreted  // Hands the rest of the routine to the interpreter.
+};
+
+struct Statement
+{
+    Kind kind = Kind::Native;
+    std::string code;
+    // Where execution continues when that's known ahead of time, or -1.
+    long next = -1;
+    // Other addresses execution may continue at: jump and skip targets, and where delegated
+    // statements most likely end.
+    std::vector<long> targets;
+};
+
+class RoutineTranslator
+{
+public:
+    explicit RoutineTranslator(long addr)
+        : addr_(addr)
+    { }
+
+    // Returns false if no statement of the routine could be translated.
+    bool translate(std::string& body);
+
+    int count(Kind kind) const;
+
+    // Routines called directly from this one.
+    const std::set<long>& calls() const
+    {
+        return calls_;
+    }
+
+private:
+    long addr_;
+    long end_ = -1;
+    // Address (including any padding in front of a statement) -> statement address.
+    std::map<long, long> entries_;
+    std::map<long, Statement> statements_;
+    std::set<long> calls_;
+    // Statements jumped to with goto.
+    std::set<long> referenced_;
+    bool generating_ = false;
+    bool need_depth_ = false;
+    bool need_tempret_ = false;
+    bool need_tempinexpr_ = false;
+    bool need_routineptr_ = false;
+    bool need_dispatch_ = false;
+    bool need_resume_ = false;
+
+    void decode(long ptr, Statement& st);
+    void decodeConditional(long ptr, Statement& st);
+    void decodeCloseBrace(long ptr, Statement& st);
+    bool decodeVarStatement(long ptr, Statement& st);
+    void delegate(long ptr, Statement& st, const char* call, long end);
+    std::string jumpTo(long target);
+    std::string label(long addr) const;
+};
+
+// Returns the address of the closing brace of the routine at 'addr', or -1. Blocks are tracked the
+// same way VerifyGame() does.
+static long routineEnd(long addr)
+{
+    std::vector<int> blocks;
+    long ptr = addr;
+    int null_count = 0;
+
+    while (ptr < codeend) {
+        const int t = MEM(ptr);
+        if (t == 0) {
+            if (++null_count > address_scale) {
+                return -1;
+            }
+            ++ptr;
+            continue;
+        }
+        null_count = 0;
+        if (t > TOKENS) {
+            return -1;
+        }
+
+        switch (t) {
+        case CLOSE_BRACE_T:
+            if (blocks.empty()) {
+                return ptr;
+            }
+            if (blocks.back() == DO_T) {
+                ptr += 3;
+            }
+            blocks.pop_back();
+            ++ptr;
+            break;
+
+        case IF_T:
+        case ELSEIF_T:
+        case ELSE_T:
+        case WHILE_T:
+        case FOR_T:
+        case CASE_T:
+        case DO_T:
+        case READFILE_T:
+        case WRITEFILE_T:
+            if (blocks.size() == MAXSTACKDEPTH) {
+                return -1;
+            }
+            blocks.push_back(t);
+            ptr += 3;
+            break;
+
+        case WINDOW_T:
+            if (not(MEM(ptr + 1) == VALUE_T and PeekWord(ptr + 2) == 0
+                    and MEM(ptr + 4) == EOL_T)) {
+                blocks.push_back(t);
+            }
+            ++ptr;
+            break;
+
+        case STRINGDATA_T:
+            ptr += 3 + PeekWord(ptr + 1);
+            break;
+
+        case DEBUGDATA_T:
+            ptr += 3 + MEM(ptr + 2);
+            break;
+
+        case TEXTDATA_T:
+            ptr += 4;
+            break;
+
+        case JUMP_T:
+        case ROUTINE_T:
+        case VALUE_T:
+        case OBJECTNUM_T:
+        case DICTENTRY_T:
+        case ARRAYDATA_T:
+            ptr += 3;
+            break;
+
+        case VAR_T:
+        case ATTR_T:
+        case PROP_T:
+        case LABEL_T:
+            ptr += 2;
+            break;
+
+        default:
+            ++ptr;
+        }
+    }
+    return -1;
+}
+
+// Returns the address following the end of line that ends the expression at 'ptr', or -1.
+static long skipToEol(long ptr, long end)
+{
+    while (ptr < end) {
+        switch (MEM(ptr)) {
+        case EOL_T:
+            return ptr + 1;
+
+        case CLOSE_BRACE_T:
+            return -1;
+
+        case STRINGDATA_T:
+            ptr += 3 + PeekWord(ptr + 1);
+            break;
+
+        case TEXTDATA_T:
+            ptr += 4;
+            break;
+
+        case JUMP_T:
+        case ROUTINE_T:
+        case VALUE_T:
+        case OBJECTNUM_T:
+        case DICTENTRY_T:
+        case ARRAYDATA_T:
+            ptr += 3;
+            break;
+
+        case VAR_T:
+        case ATTR_T:
+        case PROP_T:
+            ptr += 2;
+            break;
+
+        default:
+            ++ptr;
+        }
+    }
+    return -1;
+}
+
+static bool isIncrementOp(int t)
+{
+    return t == MINUS_T or t == PLUS_T or t == ASTERISK_T or t == FORWARD_SLASH_T
+           or t == AMPERSAND_T or t == PIPE_T;
+}
+
+// Translates a single value: a constant, or a variable GetVal() doesn't treat specially.
+static bool translateOperand(long& ptr, std::string& val)
+{
+    switch (MEM(ptr)) {
+    case VALUE_T:
+    case OBJECTNUM_T:
+    case DICTENTRY_T:
+        val = std::to_string(static_cast<short>(PeekWord(ptr + 1)));
+        ptr += 3;
+        break;
+
+    case MINUS_T:
+        if (MEM(ptr + 1) != VALUE_T) {
+            return false;
+        }
+        val = std::to_string(static_cast<short>(-static_cast<short>(PeekWord(ptr + 2))));
+        ptr += 4;
+        break;
+
+    case TRUE_T:
+        val = "1";
+        ++ptr;
+        break;
+
+    case FALSE_T:
+        val = "0";
+        ++ptr;
+        break;
+
+    case VAR_T: {
+        const int i = MEM(ptr + 1);
+        // Skip the variables GetVal() treats specially (wordcount, objectcount, etc.)
+        if (i <= objectcount + 2) {
+            return false;
+        }
+        val = "(short)var[" + std::to_string(i) + "]";
+        ptr += 2;
+        break;
+    }
+
+    default:
+        return false;
+    }
+
+    // "x++", "x += 1", etc. are increments, not operators.
+    const int t = MEM(ptr);
+    return not(isIncrementOp(t)
+               and (MEM(ptr + 1) == EQUALS_T
+                    or ((t == MINUS_T or t == PLUS_T) and MEM(ptr + 1) == t)));
+}
+
+// Translates an expression of one value, or of two values and one operator, up to and including
+// the end of line. That's the only case where we don't need to care about operator precedence.
+// The result has the value EvalExpr() would return.
+static bool translateExpr(long& ptr, std::string& val)
+{
+    std::string lhs;
+    std::string rhs;
+    long p = ptr;
+
+    if (not translateOperand(p, lhs)) {
+        return false;
+    }
+    if (MEM(p) == EOL_T) {
+        val = lhs;
+        ptr = p + 1;
+        return true;
+    }
+
+    const char* op;
+    bool truncate = true;
+    switch (MEM(p)) {
+    case PLUS_T:
+        op = "+";
+        break;
+    case MINUS_T:
+        op = "-";
+        break;
+    case ASTERISK_T:
+        op = "*";
+        break;
+    case AMPERSAND_T:
+        op = "&";
+        break;
+    case PIPE_T:
+        op = "|";
+        break;
+    case EQUALS_T:
+        op = "==";
+        truncate = false;
+        break;
+    case NOT_EQUAL_T:
+        op = "!=";
+        truncate = false;
+        break;
+    case LESS_T:
+        op = "<";
+        truncate = false;
+        break;
+    case GREATER_T:
+        op = ">";
+        truncate = false;
+        break;
+    case LESS_EQUAL_T:
+        op = "<=";
+        truncate = false;
+        break;
+    case GREATER_EQUAL_T:
+        op = ">=";
+        truncate = false;
+        break;
+    case AND_T:
+        op = "&&";
+        truncate = false;
+        break;
+    case OR_T:
+        op = "||";
+        truncate = false;
+        break;
+    default:
+        // Division needs the engine's division by zero error, and everything else needs the
+        // engine.
+        return false;
+    }
+    ++p;
+
+    if (not translateOperand(p, rhs) or MEM(p) != EOL_T) {
+        return false;
+    }
+    val = std::string(truncate ? "(short)(" : "(") + lhs + " " + op + " " + rhs + ")";
+    ptr = p + 1;
+    return true;
+}
+
+std::string RoutineTranslator::label(long addr) const
+{
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "s_%06lx", addr);
+    return buf;
+}
+
+// Returns the code that continues execution at 'target'.
+std::string RoutineTranslator::jumpTo(long target)
+{
+    const auto it = entries_.find(target);
+    if (it != entries_.end()) {
+        referenced_.insert(it->second);
+        return "goto " + label(it->second) + ";";
+    }
+    if (generating_) {
+        need_dispatch_ = true;
+    }
+    return "{codeptr = " + std::to_string(target) + "L; goto dispatch;}";
+}
+
+// Hands the statement at 'ptr' to 'call', which leaves codeptr at the next statement to run. 'end'
+// is where that most likely is, or -1.
+void RoutineTranslator::delegate(long ptr, Statement& st, const char* call, long end)
+{
+    st.kind = Kind::Delegated;
+    st.code = "\tcodeptr = " + std::to_string(ptr) + "L;\n" + call + "\tif (retflag) return;\n";
+    st.code += "\tgoto dispatch;\n";
+    if (end >= 0) {
+        st.targets.push_back(end);
+    }
+    if (generating_) {
+        need_dispatch_ = true;
+    }
+}
+
+// 'if', 'elseif', 'while', 'for', 'case' and 'else'. See RunIf().
+void RoutineTranslator::decodeConditional(long ptr, Statement& st)
+{
+    const int t = MEM(ptr);
+    const long skip = ptr + 1 + PeekWord(ptr + 1);
+    long p = ptr + 3;
+    std::string cond;
+
+    if (t != ELSE_T and not translateExpr(p, cond)) {
+        delegate(ptr, st, "\tRunIf(0);\n", skipToEol(ptr + 3, end_ + 1));
+        st.targets.push_back(skip);
+        return;
+    }
+
+    if (t != ELSE_T) {
+        st.code = "\tif (!" + cond + ")\n\t\t" + jumpTo(skip) + "\n";
+    }
+    // Protect the stack if jumping backward
+    if (MEM(p) == JUMP_T and static_cast<long>(PeekWord(p + 1)) * address_scale < p) {
+        st.code += "\tif (--stack_depth < 0) stack_depth = 0;\n";
+    }
+    const long brk = (t == WHILE_T or t == FOR_T) ? skip : 0;
+    st.code += "\tSetStackFrame(stack_depth, CONDITIONAL_BLOCK, " + std::to_string(brk)
+               + "L, 0);\n";
+    st.next = p;
+    st.targets.push_back(skip);
+}
+
+// The closing brace of a block, or of the routine itself.
+void RoutineTranslator::decodeCloseBrace(long ptr, Statement& st)
+{
+    st.code =
+        "\tif (code_block[stack_depth--].type <= RUNROUTINE_BLOCK)\n"
+        "\t{\n"
+        "\t\tif (stack_depth < 0) stack_depth = 0;\n"
+        "\t\treturn;\n"
+        "\t}\n";
+
+    // Nothing should follow the routine's own closing brace. If it does, the interpreter deals
+    // with it.
+    if (ptr == end_) {
+        st.code += "\tcodeptr = " + std::to_string(ptr + 1) + "L;\n\tgoto resume;\n";
+        if (generating_) {
+            need_resume_ = true;
+        }
+        return;
+    }
+
+    // Skip a following 'elseif' or 'else'. The skip distances are known, but a 'case' has to be
+    // evaluated.
+    long p = ptr + 1;
+    while (p <= end_ and (MEM(p) == ELSEIF_T or MEM(p) == ELSE_T)) {
+        p += 1 + PeekWord(p + 1);
+    }
+    if (p <= end_ and MEM(p) == CASE_T) {
+        st.kind = Kind::Delegated;
+        st.code += "\tcodeptr = " + std::to_string(p) + "L;\n";
+        st.code += "\twhile (MEM(codeptr)==ELSEIF_T || MEM(codeptr)==ELSE_T"
+                   " || MEM(codeptr)==CASE_T)\n";
+        st.code += "\t\tRunIf(1);\n";
+        st.code += "\tif (MEM(codeptr)==WHILE_T"
+                   " && code_block[stack_depth+1].type==DOWHILE_BLOCK)\n";
+        st.code += "\t{\n";
+        st.code += "\t\tcodeptr += 3;\n";
+        st.code += "\t\ttempinexpr = inexpr;\n\t\tinexpr = 1;\n\t\tSetupExpr();\n";
+        st.code += "\t\tinexpr = tempinexpr;\n";
+        st.code += "\t\tif (EvalExpr(0))\n";
+        st.code += "\t\t\tcodeptr = code_block[++stack_depth].returnaddr;\n";
+        st.code += "\t\telse\n\t\t\tcodeptr = code_block[stack_depth+1].brk;\n";
+        st.code += "\t}\n\tgoto dispatch;\n";
+        if (generating_) {
+            need_tempinexpr_ = need_dispatch_ = true;
+        }
+        st.targets.push_back(p);
+        return;
+    }
+
+    // The end of a 'do' block.
+    if (p <= end_ and MEM(p) == WHILE_T) {
+        long q = p + 3;
+        std::string cond;
+        st.code += "\tif (code_block[stack_depth+1].type==DOWHILE_BLOCK)\n\t{\n";
+        if (translateExpr(q, cond)) {
+            st.code += "\t\tif (" + cond + ")\n";
+        } else {
+            st.kind = Kind::Delegated;
+            st.code += "\t\tcodeptr = " + std::to_string(p + 3) + "L;\n";
+            st.code += "\t\ttempinexpr = inexpr;\n\t\tinexpr = 1;\n\t\tSetupExpr();\n";
+            st.code += "\t\tinexpr = tempinexpr;\n";
+            st.code += "\t\tif (EvalExpr(0))\n";
+            if (generating_) {
+                need_tempinexpr_ = true;
+            }
+        }
+        st.code += "\t\t\tcodeptr = code_block[++stack_depth].returnaddr;\n";
+        st.code += "\t\telse\n\t\t\tcodeptr = code_block[stack_depth+1].brk;\n";
+        st.code += "\t\tgoto dispatch;\n\t}\n";
+        if (generating_) {
+            need_dispatch_ = true;
+        }
+        const long after = skipToEol(p + 3, end_ + 1);
+        if (after >= 0) {
+            st.targets.push_back(after);
+        }
+    }
+    st.next = p;
+}
+
+// Assignments to and increments of plain variables. See RunSet().
+bool RoutineTranslator::decodeVarStatement(long ptr, Statement& st)
+{
+    const int a = MEM(ptr + 1);
+    std::string save;
+    std::string update;
+    long p = ptr + 2;
+
+    if (a < MAXGLOBALS) {
+        save = "\tSaveUndo(VAR_T, " + std::to_string(a) + ", var[" + std::to_string(a)
+               + "], 0, 0);\n";
+    }
+    if (a == wordcount) {
+        update = "\twords = var[wordcount];\n";
+    }
+
+    std::string val;
+    if (MEM(p) == EQUALS_T and MEM(p + 1) != EOL_T) {
+        ++p;
+        if (not translateExpr(p, val)) {
+            return false;
+        }
+        st.code = save + "\tinexpr = 0;\n\tvar[" + std::to_string(a) + "] = (unsigned short)"
+                  + val + ";\n" + update;
+        st.next = p;
+        return true;
+    }
+
+    // "x++" and "x--"; Increment() leaves incdec set.
+    if ((MEM(p) == PLUS_T or MEM(p) == MINUS_T) and MEM(p + 1) == MEM(p)) {
+        const int inc = MEM(p) == PLUS_T ? 1 : -1;
+        st.code = save + "\tvar[" + std::to_string(a) + "] = (short)var[" + std::to_string(a)
+                  + "] + " + std::to_string(inc) + ";\n\tincdec = " + std::to_string(inc) + ";\n"
+                  + update;
+        // Skip the end of line.
+        st.next = p + 3;
+        return true;
+    }
+    return false;
+}
+
+void RoutineTranslator::decode(long ptr, Statement& st)
+{
+    const int t = MEM(ptr);
+    char buf[160];
+
+    switch (t) {
+    case LABEL_T:
+        st.code = "\tstack_depth = initial_stack_depth + " + std::to_string(MEM(ptr + 1)) + ";\n";
+        st.next = ptr + 2;
+        if (generating_) {
+            need_depth_ = true;
+        }
+        return;
+
+    case DEBUGDATA_T:
+        if (MEM(ptr + 1) == VAR_T) {
+            st.next = ptr + 3 + MEM(ptr + 2);
+            return;
+        }
+        break;
+
+    case TEXTDATA_T: {
+        const long textaddr = Peek(ptr + 1) * 65536L + static_cast<long>(PeekWord(ptr + 2));
+        const bool sticky = MEM(ptr + 4) == SEMICOLON_T;
+        std::snprintf(buf, sizeof(buf), "\tRunTextData(%ldL, %s);\n", textaddr,
+                      sticky ? "true" : "false");
+        st.code = buf;
+        st.next = ptr + (sticky ? 5 : 4);
+        return;
+    }
+
+    case SELECT_T:
+        st.next = ptr + 1;
+        return;
+
+    case IF_T:
+    case ELSEIF_T:
+    case ELSE_T:
+    case WHILE_T:
+    case FOR_T:
+    case CASE_T:
+        decodeConditional(ptr, st);
+        return;
+
+    case DO_T: {
+        const long brk = ptr + 1 + PeekWord(ptr + 1);
+        st.code = "\tSetStackFrame(stack_depth, DOWHILE_BLOCK, " + std::to_string(brk) + "L, "
+                  + std::to_string(ptr + 3) + "L);\n";
+        st.next = ptr + 3;
+        st.targets.push_back(brk);
+        return;
+    }
+
+    case CLOSE_BRACE_T:
+        decodeCloseBrace(ptr, st);
+        return;
+
+    case JUMP_T: {
+        const long target = static_cast<long>(PeekWord(ptr + 1)) * address_scale;
+        st.code = "\t" + jumpTo(target) + "\n";
+        st.targets.push_back(target);
+        return;
+    }
+
+    case BREAK_T:
+        st.code =
+            "\tfor (; stack_depth>0; stack_depth--)\n"
+            "\t{\n"
+            "\t\tif (code_block[stack_depth].brk)\n"
+            "\t\t{\n"
+            "\t\t\tcodeptr = code_block[stack_depth].brk;\n"
+            "\t\t\t--stack_depth;\n"
+            "\t\t\tgoto dispatch;\n"
+            "\t\t}\n"
+            "\t}\n";
+        st.next = ptr + 1;
+        if (generating_) {
+            need_dispatch_ = true;
+        }
+        return;
+
+    case RETURN_T: {
+        long p = ptr + 1;
+        std::string val;
+        if (MEM(p) == EOL_T) {
+            val = "0";
+        } else if (not translateExpr(p, val)) {
+            // Let 'return Routine()' or 'return obj.prop' set up tail recursion.
+            st.kind = Kind::Delegated;
+            st.code = "\tcodeptr = " + std::to_string(ptr + 1) + "L;\n";
+            st.code +=
+                "\ttempinexpr = inexpr;\n"
+                "\tinexpr = 1;\n"
+                "\ttail_recursion = 0;\n"
+                "\ttail_recursion_addr = 0;\n"
+                "\tSetupExpr();\n"
+                "\tinexpr = tempinexpr;\n"
+                "\tif (tail_recursion)\n"
+                "\t{\n"
+                "\t\tHandleTailRecursion(tail_recursion_addr);\n"
+                "\t\tgoto dispatch;\n"
+                "\t}\n"
+                "\ttail_recursion = 0;\n"
+                "\ttail_recursion_addr = 0;\n"
+                "\tret = EvalExpr(0);\n"
+                "\tretflag = true;\n"
+                "\treturn;\n";
+            if (generating_) {
+                need_tempinexpr_ = need_dispatch_ = true;
+            }
+            return;
+        }
+        st.code = "\ttail_recursion = 0;\n\ttail_recursion_addr = 0;\n\tret = " + val
+                  + ";\n\tretflag = true;\n\treturn;\n";
+        return;
+    }
+
+    case VAR_T:
+        if (decodeVarStatement(ptr, st)) {
+            return;
+        }
+        delegate(ptr, st, "\tRunSet(-1);\n", skipToEol(ptr, end_ + 1));
+        return;
+
+    case OBJECTNUM_T:
+    case VALUE_T:
+    case WORD_T:
+    case ARRAYDATA_T:
+    case ARRAY_T:
+        delegate(ptr, st, "\tRunSet(-1);\n", skipToEol(ptr, end_ + 1));
+        return;
+
+    case PARENT_T:
+    case SIBLING_T:
+    case CHILD_T:
+    case YOUNGEST_T:
+    case ELDEST_T:
+    case YOUNGER_T:
+    case ELDER_T:
+        delegate(ptr, st, "\tinobj = true;\n\tRunSet(GetVal());\n\tinobj = false;\n",
+                 skipToEol(ptr, end_ + 1));
+        return;
+
+    case ROUTINE_T: {
+        const long routine = static_cast<long>(PeekWord(ptr + 1)) * address_scale;
+        if (routine != 0 and routine < codeend) {
+            calls_.insert(routine);
+        }
+        // Guess where the arguments end.
+        long end = ptr + 3;
+        if (MEM(end) == OPEN_BRACKET_T) {
+            int brackets = 0;
+            do {
+                if (MEM(end) == OPEN_BRACKET_T) {
+                    ++brackets;
+                } else if (MEM(end) == CLOSE_BRACKET_T) {
+                    --brackets;
+                }
+                switch (MEM(end)) {
+                case VALUE_T:
+                case OBJECTNUM_T:
+                case DICTENTRY_T:
+                case ARRAYDATA_T:
+                case ROUTINE_T:
+                    end += 3;
+                    break;
+                case VAR_T:
+                case ATTR_T:
+                case PROP_T:
+                    end += 2;
+                    break;
+                case STRINGDATA_T:
+                    end += 3 + PeekWord(end + 1);
+                    break;
+                default:
+                    ++end;
+                }
+            } while (brackets > 0 and end <= end_);
+        }
+        if (MEM(end) == DECIMAL_T or MEM(end) == IS_T) {
+            end = skipToEol(end, end_ + 1);
+        }
+        std::snprintf(buf, sizeof(buf),
+                      "\tcodeptr += 3;\n"
+                      "\ttempret = ret;\n"
+                      "\tCallRoutine(%uU);\n"
+                      "\tif (MEM(codeptr)==DECIMAL_T || MEM(codeptr)==IS_T)\n"
+                      "\t\tRunSet(ret);\n"
+                      "\tret = tempret;\n",
+                      PeekWord(ptr + 1));
+        delegate(ptr, st, buf, end);
+        if (generating_) {
+            need_tempret_ = true;
+        }
+        return;
+    }
+
+    case CALL_T:
+        delegate(ptr, st,
+                 "\tcodeptr++;\n"
+                 "\troutineptr = GetValue();\n"
+                 "\ttempret = ret;\n"
+                 "\tCallRoutine(routineptr);\n"
+                 "\tif (MEM(codeptr)==DECIMAL_T || MEM(codeptr)==IS_T)\n"
+                 "\t\tRunSet(ret);\n"
+                 "\telse\n"
+                 "\t\tcodeptr++; /* eol */\n"
+                 "\tret = tempret;\n",
+                 skipToEol(ptr, end_ + 1));
+        if (generating_) {
+            need_tempret_ = need_routineptr_ = true;
+        }
+        return;
+
+    case RUN_T:
+        delegate(ptr, st,
+                 "\tcodeptr++;\n"
+                 "\ttempret = ret;\n"
+                 "\tGetValue();\n"
+                 "\tret = tempret;\n"
+                 "\tcodeptr++; /* eol */\n",
+                 skipToEol(ptr, end_ + 1));
+        if (generating_) {
+            need_tempret_ = true;
+        }
+        return;
+
+    case MINUS_T:
+    case PLUS_T:
+        delegate(ptr, st, "\tGetValue();\n\tcodeptr++; /* eol */\n", skipToEol(ptr, end_ + 1));
+        return;
+
+    case PRINT_T:
+        delegate(ptr, st, "\tRunPrint();\n", skipToEol(ptr, end_ + 1));
+        return;
+
+    case MOVE_T:
+    case REMOVE_T:
+        delegate(ptr, st, "\tRunMove();\n", skipToEol(ptr, end_ + 1));
+        return;
+
+    case STRING_T:
+        delegate(ptr, st, "\tRunString();\n", skipToEol(ptr, end_ + 1));
+        return;
+
+    case SYSTEM_T:
+        delegate(ptr, st, "\tRunSystem();\n\tcodeptr++; /* eol */\n", skipToEol(ptr, end_ + 1));
+        return;
+
+    case WINDOW_T:
+        delegate(ptr, st, "\tRunWindow();\n", -1);
+        return;
+
+    case WRITEFILE_T:
+    case READFILE_T:
+        delegate(ptr, st, "\tFileIO();\n", -1);
+        return;
+    }
+
+    // Everything else is left to the interpreter.
+    st.kind = Kind::Interpreted;
+    st.code = "\tcodeptr = " + std::to_string(ptr) + "L;\n\tgoto resume;\n";
+    if (generating_) {
+        need_resume_ = true;
+    }
+}
+
+bool RoutineTranslator::translate(std::string& body)
+{
+    if ((end_ = routineEnd(addr_)) < 0) {
+        return false;
+    }
+
+    // Find the statements of the routine, starting with the first one and following every
+    // address execution can continue at.
+    std::vector<long> work{addr_};
+    while (not work.empty()) {
+        const long entry = work.back();
+        work.pop_back();
+        if (entry < addr_ or entry > end_ or entries_.count(entry) != 0) {
+            continue;
+        }
+
+        // Padding up to the address boundary.
+        long ptr = entry;
+        for (int null_count = 0; ptr <= end_ and MEM(ptr) == 0; ++ptr) {
+            if (++null_count > address_scale) {
+                break;
+            }
+        }
+        if (ptr > end_ or MEM(ptr) == 0 or MEM(ptr) > TOKENS) {
+            continue;
+        }
+        entries_[entry] = ptr;
+        entries_[ptr] = ptr;
+        if (statements_.count(ptr) != 0) {
+            continue;
+        }
+
+        Statement st;
+        decode(ptr, st);
+        if (st.next >= 0) {
+            work.push_back(st.next);
+        }
+        work.insert(work.end(), st.targets.begin(), st.targets.end());
+        statements_[ptr] = st;
+    }
+    if (count(Kind::Interpreted) == static_cast<int>(statements_.size())) {
+        return false;
+    }
+
+    // Now that all the labels are known, generate the code.
+    generating_ = true;
+    for (auto it = statements_.begin(); it != statements_.end(); ++it) {
+        Statement& st = it->second;
+        st = Statement();
+        decode(it->first, st);
+
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), "\tNATIVE_STATEMENT(%ldL)\n", addr_);
+        st.code.insert(0, buf);
+        if (st.next < 0) {
+            continue;
+        }
+        const auto next = entries_.find(st.next);
+        const auto following = std::next(it);
+        if (next == entries_.end() or following == statements_.end()
+            or next->second != following->first) {
+            st.code += "\t" + jumpTo(st.next) + "\n";
+        }
+    }
+
+    body.clear();
+    if (need_depth_ or need_dispatch_ or need_resume_) {
+        body += "\tint initial_stack_depth = stack_depth;\n";
+    }
+    if (need_tempret_) {
+        body += "\tint tempret;\n";
+    }
+    if (need_tempinexpr_) {
+        body += "\tchar tempinexpr;\n";
+    }
+    if (need_routineptr_) {
+        body += "\tunsigned int routineptr;\n";
+    }
+    if (not body.empty()) {
+        body += "\n";
+    }
+    for (const auto& st : statements_) {
+        // Only emit the labels we use.
+        if (need_dispatch_ or referenced_.count(st.first) != 0) {
+            body += label(st.first) + ":\n";
+        }
+        body += st.second.code;
+    }
+
+    if (need_dispatch_) {
+        body += "dispatch:\n\tswitch (codeptr)\n\t{\n";
+        for (const auto& entry : entries_) {
+            body += "\t\tcase " + std::to_string(entry.first) + "L: goto " + label(entry.second)
+                    + ";\n";
+        }
+        body += "\t}\n";
+    }
+    if (need_resume_) {
+        body += "resume:\n";
+    }
+    if (need_dispatch_ or need_resume_) {
+        body += "\tResumeRoutine(initial_stack_depth);\n";
+    }
+    return true;
+}
+
+int RoutineTranslator::count(Kind kind) const
+{
+    int n = 0;
+    for (const auto& st : statements_) {
+        if (st.second.kind == kind) {
+            ++n;
+        }
+    }
+    return n;
+}
+
+// Collects the addresses of the routines in the game's tables: the header, the event table and
+// the (non-complex) property routines of every object.
+static std::set<long> findRoutines()
+{
+    std::set<long> addrs;
+
+    for (unsigned int addr : {initaddr, mainaddr, parseaddr, parseerroraddr, findobjectaddr,
+                              endgameaddr, speaktoaddr, performaddr}) {
+        if (addr != 0) {
+            addrs.insert(static_cast<long>(addr) * address_scale);
+        }
+    }
+
+    defseg = eventtable;
+    for (int i = 0; i < events; ++i) {
+        const unsigned int addr = PeekWord(2 + i * 4 + 2);
+        if (addr != 0) {
+            addrs.insert(static_cast<long>(addr) * address_scale);
+        }
+    }
+
+    for (int obj = 0; obj < objects; ++obj) {
+        defseg = objtable;
+        unsigned int ptr = PeekWord(object_size * (obj + 1));
+
+        defseg = proptable;
+        for (int p = Peek(ptr); p != PROP_END; p = Peek(ptr)) {
+            int proplen = Peek(ptr + 1);
+            if (proplen == PROP_ROUTINE) {
+                if ((Peek(2 + Peek(0) * 2 + p) & COMPLEX_FLAG) == 0) {
+                    addrs.insert(static_cast<long>(PeekWord(ptr + 2)) * address_scale);
+                }
+                proplen = 1;
+            }
+            ptr += proplen * 2 + 2;
+        }
+    }
+
+    defseg = gameseg;
+    return addrs;
+}
+
+bool translateGame(const char* outFile)
+{
+    FILE* out = std::fopen(outFile, "w");
+    if (out == nullptr) {
+        std::perror(outFile);
+        return false;
+    }
+
+    std::map<long, std::string> bodies;
+    std::set<long> seen;
+    int counts[3] = {0, 0, 0};
+
+    // Older games encode statements differently. We don't bother with them.
+    if (game_version >= 25) {
+        // Start with the routines in the game's tables, and follow the routines they call.
+        std::set<long> work = findRoutines();
+        while (not work.empty()) {
+            const long addr = *work.begin();
+            work.erase(work.begin());
+            if (not seen.insert(addr).second or addr % address_scale != 0) {
+                continue;
+            }
+
+            RoutineTranslator routine(addr);
+            std::string body;
+            const bool ok = routine.translate(body);
+            for (long call : routine.calls()) {
+                if (seen.count(call) == 0) {
+                    work.insert(call);
+                }
+            }
+            if (not ok) {
+                continue;
+            }
+            bodies[addr] = body;
+            counts[0] += routine.count(Kind::Native);
+            counts[1] += routine.count(Kind::Delegated);
+            counts[2] += routine.count(Kind::Interpreted);
+        }
+    }
+
+    const int total = counts[0] + counts[1] + counts[2];
+    char coverage[160];
+    std::snprintf(coverage, sizeof(coverage),
+                  "%zu of %zu routines translated. Of their %d statements, %d run natively, %d "
+                  "through the engine and %d in the interpreter.",
+                  bodies.size(), seen.size(), total, counts[0], counts[1], counts[2]);
+
+    std::fprintf(out, "/* Generated by hugor-cli from \"%s\". Do not edit.\n\n   %s\n*/\n\n",
+                 gamefile, coverage);
+    std::fprintf(out, "#include \"heheader.h\"\n\n");
+    for (const auto& routine : bodies) {
+        std::fprintf(out, "static void routine_%06lx(void)\n{\n%s}\n\n", routine.first,
+                     routine.second.c_str());
+    }
+
+    std::fprintf(out, "const char native_routine_serial[] = \"%s\";\n", serial);
+    std::fprintf(out, "const long native_routine_codeend = %ldL;\n", codeend);
+    std::fprintf(out, "const int native_routine_count = %zu;\n\n", bodies.size());
+    std::fprintf(out, "const struct NATIVE_ROUTINE native_routine_table[] =\n{\n");
+    for (const auto& routine : bodies) {
+        std::fprintf(out, "\t{%ldL, routine_%06lx},\n", routine.first, routine.first);
+    }
+    // C doesn't allow empty arrays.
+    if (bodies.empty()) {
+        std::fprintf(out, "\t{0L, NULL}\n");
+    }
+    std::fprintf(out, "};\n");
+
+    const bool ok = std::ferror(out) == 0;
+    std::fclose(out);
+    std::fprintf(stderr, "%s\n", coverage);
+    return ok;
+}
+
+/* Copyright (C) 2011-2019 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ */
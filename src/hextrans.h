@@ -0,0 +1,30 @@
+// This is copyrighted software. More information is at the end of this file.
+#pragma once
+
+// Translates the routines of the currently loaded game (see LoadGame()) to C and writes the result
+// to 'outFile'. The generated file is meant to be built into Hugor or hugor-cli with:
+//
+//   qmake hugor.pro NATIVE_ROUTINES=<outFile>
+//   qmake hugor-cli.pro NATIVE_ROUTINES=<outFile>
+//
+// Statements that can't be translated are run by the engine. Prints how much of the game was
+// translated to stderr. Returns false if the output file could not be written.
+bool translateGame(const char* outFile);
+
+/* Copyright (C) 2011-2019 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ */
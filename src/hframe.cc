@@ -3,6 +3,7 @@
 
 #include <QClipboard>
 #include <QDebug>
+#include <QEasingCurve>
 #include <QHBoxLayout>
 #include <QKeyEvent>
 #include <QMenu>
@@ -10,6 +11,8 @@
 #include <QTextCodec>
 #include <QTimer>
 #include <QWindow>
+#include <algorithm>
+#include <cmath>
 
 #include "happlication.h"
 extern "C" {
@@ -28,10 +31,27 @@ static qreal dpr()
     return hMainWin->windowHandle()->devicePixelRatio();
 }
 
+static QFont fontForType(const int hugoFont)
+{
+    QFont f(hugoFont & PROP_FONT ? hApp->settings().prop_font : hApp->settings().fixed_font);
+    f.setUnderline(hugoFont & UNDERLINE_FONT);
+    f.setItalic(hugoFont & ITALIC_FONT);
+    f.setBold(hugoFont & BOLD_FONT);
+    return f;
+}
+
+static void prepareStaticText(QStaticText& st, const QString& text, const QFont& font)
+{
+    st.setTextFormat(Qt::PlainText);
+    st.setText(text);
+    st.prepare(QTransform(), font);
+}
+
 HFrame::HFrame(QWidget* parent)
     : QWidget(parent)
     , cursor_height_(QFontMetrics(hApp->settings().prop_font).height())
     , blink_timer_(new QTimer(this))
+    , screen_update_timer_(new QTimer(this))
     , minimize_timer_(new QTimer(this))
 {
     // We handle player input, so we need to accept focus.
@@ -44,6 +64,14 @@ HFrame::HFrame(QWidget* parent)
     // We need to check whether the application lost focus.
     connect(qApp, &QApplication::focusChanged, this, &HFrame::handleFocusChange);
 
+    // The engine doesn't ask for screen updates. Whatever it printed shows up on the next tick.
+    connect(screen_update_timer_, &QTimer::timeout, this, [this] {
+        advanceSoftScroll();
+        advanceFade();
+        updateGameScreen(false);
+    });
+    screen_update_timer_->start(16);
+
     minimize_timer_->setSingleShot(true);
     connect(minimize_timer_, &QTimer::timeout, this, &HFrame::handleFocusLost);
 
@@ -53,24 +81,28 @@ HFrame::HFrame(QWidget* parent)
 
     setAttribute(Qt::WA_InputMethodEnabled);
     setAttribute(Qt::WA_OpaquePaintEvent);
+
+    // The engine might measure text before it sets a font.
+    font_type_ = PROP_FONT;
+    updateFontMetricsSet();
     hFrame = this;
 }
 
-void HFrame::enqueueKey(char key, QMouseEvent* e)
+void HFrame::enqueueKey(char key, Qt::KeyboardModifiers modifiers, QMouseEvent* e)
 {
-    QMutexLocker mKeyLocker(&key_queue_mutex_);
-    QMutexLocker mClickLocker(&click_queue_mutex_);
-    // Only allow one keypress or click in the queue. No reason to use a queue for that, but we
-    // might still want the possibilty to change this to allow multiple keys/clicks to queue up, if
-    // the need for that arises.
-    if (key_queue_.empty()) {
-        key_queue_.enqueue(key);
-        if (e != nullptr) {
-            click_queue_.append(e->pos());
-        }
+    const size_t tail = input_tail_.load(std::memory_order_relaxed);
+
+    // If the game isn't reading input, drop what doesn't fit.
+    if (tail - input_head_.load(std::memory_order_acquire) >= INPUT_RING_SIZE) {
+        return;
     }
-    mKeyLocker.unlock();
-    mClickLocker.unlock();
+    input_ring_[tail & (INPUT_RING_SIZE - 1)] = {key, modifiers,
+                                                 e != nullptr ? e->pos() : QPoint()};
+    input_tail_.store(tail + 1, std::memory_order_release);
+
+    // Taking the mutex makes sure we can't wake the engine between its check for input and its
+    // wait.
+    QMutexLocker locker(&input_wait_mutex_);
     keypressAvailableWaitCond.wakeAll();
 }
 
@@ -97,6 +129,33 @@ void HFrame::updateCursorShape()
     }
 }
 
+void HFrame::updateFontMetricsSet()
+{
+    // The engine might still be measuring text with the previous set, so we never modify one in
+    // place. Snapshots of fonts that didn't change are shared with the previous set.
+    auto new_set = std::make_shared<FontMetricsSet>();
+    bool changed = metrics_set_ == nullptr;
+    fonts_.clear();
+    for (int i = 0; i < 16; ++i) {
+        const QFont& f = fontForType(i);
+        fonts_.push_back({f, QFontMetrics(f)});
+        if (metrics_set_ != nullptr and (*metrics_set_)[i]->font() == f) {
+            (*new_set)[i] = (*metrics_set_)[i];
+        } else {
+            (*new_set)[i] = std::make_shared<const FontMetricsSnapshot>(f, hApp->hugoCodec());
+            changed = true;
+        }
+    }
+    if (changed) {
+        std::atomic_store(&metrics_set_, std::shared_ptr<const FontMetricsSet>(new_set));
+        metrics_generation_.fetch_add(1, std::memory_order_release);
+    }
+    font_metrics_ = fonts_[font_type_].metrics;
+    text_cache_.clear();
+    text_seen_.clear();
+    input_text_ = QStaticText();
+}
+
 void HFrame::blinkCursor()
 {
     is_blink_visible_ = not is_blink_visible_;
@@ -177,20 +236,33 @@ void HFrame::paintEvent(QPaintEvent* e)
     QRectF src_rect(e->rect().topLeft() * dpr(),
                     QSizeF(e->rect().width(), e->rect().height()) * dpr());
     p.drawPixmap(e->rect(), pixmap_, src_rect);
+    if (soft_scroll_offset_ > 0) {
+        paintSoftScroll(p);
+    }
+    paintInputAndCursor(p);
 
+    // Blend everything with the margin color while the screen is faded out.
+    if (fade_alpha_ < 1.0) {
+        QColor c = hApp->marginWidget()->color();
+        c.setAlphaF(1.0 - fade_alpha_);
+        p.fillRect(e->rect(), c);
+    }
+}
+
+void HFrame::paintInputAndCursor(QPainter& p)
+{
     // Draw our current input. We need to do this here, after the pixmap has already been painted,
     // so that the input gets painted on top. Otherwise, we could not erase text during editing.
-    QFont f(use_fixed_font_ ? hApp->settings().fixed_font : hApp->settings().prop_font);
-    f.setUnderline(use_underline_font_);
-    f.setItalic(use_italic_font_);
-    f.setBold(use_bold_font_);
-    QFontMetrics m(f);
-    p.setFont(f);
+    const QFontMetrics& m = font_metrics_;
+    p.setFont(currentFont());
     if (input_mode_ == InputMode::Normal and not input_buf_.isEmpty()) {
+        if (input_text_.text() != input_buf_) {
+            prepareStaticText(input_text_, input_buf_, currentFont());
+        }
+        p.fillRect(input_start_x_, input_start_y_, m.width(input_buf_), m.height(),
+                   hugoColorToQt(bg_color_));
         p.setPen(hugoColorToQt(fg_color_));
-        p.setBackgroundMode(Qt::OpaqueMode);
-        p.setBackground(QBrush(hugoColorToQt(bg_color_)));
-        p.drawText(input_start_x_, input_start_y_ + m.ascent(), input_buf_);
+        p.drawStaticText(input_start_x_, input_start_y_, input_text_);
     }
 
     if (not is_cursor_visible_ or not is_blink_visible_) {
@@ -252,10 +324,14 @@ void HFrame::resizeEvent(QResizeEvent* e)
     newPixmap.setDevicePixelRatio(dpr());
     newPixmap.fill(hugoColorToQt(bg_color_));
 
-    // Draw the current pixmap into the new one and use it as our new display.
+    // Render the screen again from our model rather than copying the old pixels. This keeps
+    // things sharp if the pixel ratio changed, and brings back anything that was cut off by a
+    // previous, smaller size. The game still gets to redraw for the new size when it's ready.
     QPainter p(&newPixmap);
-    p.drawPixmap(0, 0, pixmap_);
+    screen_model_.paint(p);
+    p.end();
     pixmap_ = newPixmap;
+    stopSoftScroll();
 
     HugoHandlers::settextmode();
     display_needs_repaint = true;
@@ -422,7 +498,7 @@ void HFrame::inputMethodEvent(QInputMethodEvent* e)
         QWidget::inputMethodEvent(e);
         return;
     }
-    enqueueKey(bytes[0], nullptr);
+    enqueueKey(bytes[0], QApplication::keyboardModifiers(), nullptr);
 }
 
 void HFrame::singleKeyPressEvent(QKeyEvent* event)
@@ -437,19 +513,19 @@ void HFrame::singleKeyPressEvent(QKeyEvent* event)
         return;
 
     case Qt::Key_Left:
-        enqueueKey(8, nullptr);
+        enqueueKey(8, event->modifiers(), nullptr);
         break;
 
     case Qt::Key_Up:
-        enqueueKey(11, nullptr);
+        enqueueKey(11, event->modifiers(), nullptr);
         break;
 
     case Qt::Key_Right:
-        enqueueKey(21, nullptr);
+        enqueueKey(21, event->modifiers(), nullptr);
         break;
 
     case Qt::Key_Down:
-        enqueueKey(10, nullptr);
+        enqueueKey(10, event->modifiers(), nullptr);
         break;
 
     default:
@@ -458,7 +534,7 @@ void HFrame::singleKeyPressEvent(QKeyEvent* event)
             QWidget::keyPressEvent(event);
             return;
         }
-        enqueueKey(event->text().at(0).toLatin1(), nullptr);
+        enqueueKey(event->text().at(0).toLatin1(), event->modifiers(), nullptr);
     }
 }
 
@@ -469,7 +545,7 @@ void HFrame::mousePressEvent(QMouseEvent* e)
         return;
     }
     if (input_mode_ == InputMode::None) {
-        enqueueKey(0, e);
+        enqueueKey(0, e->modifiers(), e);
     }
     e->accept();
 }
@@ -506,11 +582,11 @@ void HFrame::startInput(int xPos, int yPos)
     input_start_x_ = xPos;
     input_start_y_ = yPos;
     input_current_char_ = 0;
+    update(inputLineRect());
 
-    QMutexLocker mKeyLocker(&key_queue_mutex_);
-    QMutexLocker mClickLocker(&click_queue_mutex_);
-    key_queue_.clear();
-    click_queue_.clear();
+    // Drop pending keypresses and clicks. The engine thread is waiting for us to return, so it's
+    // safe to move its read position.
+    input_head_.store(input_tail_.load(std::memory_order_relaxed), std::memory_order_release);
 }
 
 void HFrame::getInput(char* buf, size_t buflen)
@@ -520,39 +596,48 @@ void HFrame::getInput(char* buf, size_t buflen)
     input_buf_.clear();
 }
 
-int HFrame::getNextKey()
+void HFrame::waitForInputEvent()
 {
-    // qDebug() << Q_FUNC_INFO;
-    QMutexLocker mLocker(&key_queue_mutex_);
-    Q_ASSERT(not key_queue_.isEmpty());
-    return key_queue_.dequeue();
-}
-
-QPoint HFrame::getNextClick()
-{
-    QMutexLocker mLocker(&click_queue_mutex_);
-    Q_ASSERT(not click_queue_.isEmpty());
-    return click_queue_.dequeue();
+    QMutexLocker locker(&input_wait_mutex_);
+    while (not hasInputEvent()) {
+        keypressAvailableWaitCond.wait(&input_wait_mutex_);
+    }
 }
 
-bool HFrame::hasKeyInQueue()
+HFrame::InputEvent HFrame::takeInputEvent()
 {
-    QMutexLocker mLocker(&key_queue_mutex_);
-    return not key_queue_.isEmpty();
+    // qDebug() << Q_FUNC_INFO;
+    Q_ASSERT(hasInputEvent());
+    const size_t head = input_head_.load(std::memory_order_relaxed);
+    const InputEvent event = input_ring_[head & (INPUT_RING_SIZE - 1)];
+    input_head_.store(head + 1, std::memory_order_release);
+    return event;
 }
 
 void HFrame::clearRegion(qreal left, qreal top, qreal right, qreal bottom)
 {
     // qDebug(Q_FUNC_INFO);
     flushText();
-    need_screen_update_ = true;
+    ScreenRun run;
+    run.kind = ScreenRun::Kind::Fill;
+    run.bg = hugoColorToQt(bg_color_);
     if (left == 0 and top == 0 and right == 0 and bottom == 0) {
-        pixmap_.fill(hugoColorToQt(bg_color_));
+        pixmap_.fill(run.bg);
+        dirty_region_ = rect();
+        run.rect = rect();
+        run.clip = run.rect;
+        screen_model_.clear();
+        stopSoftScroll();
+        screen_model_.add(std::move(run));
         return;
     }
     QPainter p(&pixmap_);
     QRectF rect(left, top, right - left + 1, bottom - top + 1);
-    p.fillRect(rect, hugoColorToQt(bg_color_));
+    p.fillRect(rect, run.bg);
+    dirty_region_ += rect.toAlignedRect();
+    run.rect = rect.toAlignedRect();
+    run.clip = run.rect;
+    screen_model_.add(std::move(run));
 
     // If this was a fullscreen clear, then also clear the margin color.
     if (rect == pixmap_.rect()) {
@@ -575,16 +660,11 @@ void HFrame::setBgColor(int color)
 void HFrame::setFontType(int hugoFont)
 {
     flushText();
-    use_fixed_font_ = not(hugoFont & PROP_FONT);
-    use_underline_font_ = hugoFont & UNDERLINE_FONT;
-    use_italic_font_ = hugoFont & ITALIC_FONT;
-    use_bold_font_ = hugoFont & BOLD_FONT;
-
-    QFont f(use_fixed_font_ ? hApp->settings().fixed_font : hApp->settings().prop_font);
-    f.setUnderline(use_underline_font_);
-    f.setItalic(use_italic_font_);
-    f.setBold(use_bold_font_);
-    font_metrics_ = QFontMetrics(f);
+    if ((hugoFont & 15) != font_type_) {
+        font_type_ = hugoFont & 15;
+        font_metrics_ = fonts_[font_type_].metrics;
+        input_text_ = QStaticText();
+    }
 
     // Adjust text caret for new font.
     updateCursorShape();
@@ -602,9 +682,16 @@ void HFrame::printText(const QString& str, int x, int y)
 void HFrame::printImage(const QImage& img, int x, int y)
 {
     flushText();
+    ScreenRun run;
+    run.kind = ScreenRun::Kind::Image;
+    run.pos = QPoint(x, y);
+    run.rect = QRect(run.pos, img.size() / img.devicePixelRatio());
+    run.clip = run.rect;
+    run.image = img;
     QPainter p(&pixmap_);
-    p.drawImage(x, y, img);
-    need_screen_update_ = true;
+    ScreenModel::paintRun(p, run);
+    dirty_region_ += run.rect;
+    screen_model_.add(std::move(run));
 }
 
 void HFrame::scrollUp(int left, int top, int right, int bottom, int h)
@@ -614,28 +701,125 @@ void HFrame::scrollUp(int left, int top, int right, int bottom, int h)
     }
 
     flushText();
-    QRegion exposed;
     ++right;
     ++bottom;
+    if (hApp->settings().soft_text_scrolling) {
+        startSoftScroll(QRect(left, top, right - left, bottom - top), h);
+    }
     pixmap_.scroll(0, -h * dpr(), left * dpr(), top * dpr(), (right - left) * dpr(),
-                   (bottom - top) * dpr(), &exposed);
-    need_screen_update_ = true;
+                   (bottom - top) * dpr());
+    dirty_region_ += QRect(left, top, right - left, bottom - top);
+    screen_model_.scroll(QRect(left, top, right - left, bottom - top), h);
+
+    // Fill the exposed strip at the bottom of the area, and record the fill so that re-rendering
+    // uses the color it was drawn with.
+    ScreenRun run;
+    run.kind = ScreenRun::Kind::Fill;
+    run.bg = hugoColorToQt(bg_color_);
+    const int exposed_height = std::min(h, bottom - top);
+    run.rect = QRect(left, bottom - exposed_height, right - left, exposed_height);
+    run.clip = run.rect;
+    QPainter p(&pixmap_);
+    p.fillRect(run.rect, run.bg);
+    screen_model_.add(std::move(run));
+}
 
-    // Fill exposed region.
-    const QRect& r = exposed.boundingRect();
-    clearRegion(r.left() / dpr(), r.top() / dpr(), (r.left() + r.width()) / dpr(),
-                (r.top() + r.bottom()) / dpr());
+void HFrame::startSoftScroll(const QRect& area, int h)
+{
+    // Scrolls of different text windows don't mix; just finish the previous one.
+    if (area != soft_scroll_area_) {
+        stopSoftScroll();
+    }
+    if (soft_scroll_offset_ == 0) {
+        soft_scroll_clock_.start();
+    }
+    soft_scroll_area_ = area;
+    h = std::min(h, area.height());
 
-    if (hApp->settings().soft_text_scrolling) {
-        QEventLoop idleLoop;
-        QTimer timer;
-        timer.setSingleShot(true);
-        connect(&timer, &QTimer::timeout, &idleLoop, &QEventLoop::quit);
-        connect(hApp, &HApplication::gameQuitting, &idleLoop, &QEventLoop::quit);
-        timer.start(12);
-        idleLoop.exec();
+    // Build a new strip out of the part of the old one that is still on its way out, followed by
+    // the rows that are about to be scrolled out of the area.
+    const int keep = std::min(static_cast<int>(std::ceil(soft_scroll_offset_)),
+                              area.height() - h);
+    QPixmap strip(QSize(area.width(), keep + h) * dpr());
+    strip.setDevicePixelRatio(dpr());
+    QPainter p(&strip);
+    if (keep > 0) {
+        p.drawPixmap(QRectF(0, 0, area.width(), keep), soft_scroll_strip_,
+                     QRectF(0, soft_scroll_strip_.height() - keep * dpr(), area.width() * dpr(),
+                            keep * dpr()));
     }
-    updateGameScreen(false);
+    p.drawPixmap(QRectF(0, keep, area.width(), h), pixmap_,
+                 QRectF(QPointF(area.topLeft()) * dpr(), QSizeF(area.width(), h) * dpr()));
+    p.end();
+    soft_scroll_strip_ = strip;
+    soft_scroll_offset_ = std::min(soft_scroll_offset_ + h, static_cast<qreal>(area.height()));
+}
+
+void HFrame::advanceSoftScroll()
+{
+    if (soft_scroll_offset_ == 0) {
+        return;
+    }
+
+    // Ease out, halving the distance every 20ms. Consecutive scrolls just add to the distance, so
+    // a screenful of text doesn't take any longer to animate than a single line.
+    soft_scroll_offset_ *= std::pow(0.5, soft_scroll_clock_.restart() / 20.0);
+    if (soft_scroll_offset_ < 0.5) {
+        stopSoftScroll();
+    }
+    update(soft_scroll_area_);
+}
+
+void HFrame::stopSoftScroll()
+{
+    if (soft_scroll_offset_ > 0) {
+        update(soft_scroll_area_);
+    }
+    soft_scroll_offset_ = 0;
+    soft_scroll_strip_ = QPixmap();
+}
+
+void HFrame::fadeScreen(const int duration, const qreal startAlpha, const qreal endAlpha)
+{
+    fade_start_alpha_ = startAlpha < 0 ? fade_alpha_ : startAlpha;
+    fade_end_alpha_ = endAlpha;
+    fade_duration_ = duration;
+    fade_clock_.start();
+    is_fading_ = true;
+    advanceFade();
+}
+
+void HFrame::advanceFade()
+{
+    if (not is_fading_) {
+        return;
+    }
+
+    const qreal progress =
+        fade_duration_ > 0 ? std::min(1.0, fade_clock_.elapsed() / qreal(fade_duration_)) : 1.0;
+    fade_alpha_ = fade_start_alpha_
+                  + (fade_end_alpha_ - fade_start_alpha_)
+                        * QEasingCurve(QEasingCurve::OutQuad).valueForProgress(progress);
+    if (progress >= 1.0) {
+        is_fading_ = false;
+    }
+    update();
+}
+
+void HFrame::paintSoftScroll(QPainter& p)
+{
+    const QRect& a = soft_scroll_area_;
+    const int offs = std::min(qRound(soft_scroll_offset_),
+                              static_cast<int>(soft_scroll_strip_.height() / dpr()));
+
+    // Rows that were scrolled out of the area but haven't finished moving out yet, followed by
+    // what's currently in the area, moved down by the remaining offset.
+    p.drawPixmap(QRectF(a.left(), a.top(), a.width(), offs), soft_scroll_strip_,
+                 QRectF(0, soft_scroll_strip_.height() - offs * dpr(), a.width() * dpr(),
+                        offs * dpr()));
+    p.drawPixmap(
+        QRectF(a.left(), a.top() + offs, a.width(), a.height() - offs), pixmap_,
+        QRectF(QPointF(a.topLeft()) * dpr(), QSizeF(a.width(), a.height() - offs) * dpr()));
 }
 
 void HFrame::flushText()
@@ -644,42 +828,74 @@ void HFrame::flushText()
         return;
     }
 
-    QFont f(use_fixed_font_ ? hApp->settings().fixed_font : hApp->settings().prop_font);
-    f.setUnderline(use_underline_font_);
-    f.setItalic(use_italic_font_);
-    f.setBold(use_bold_font_);
-    QPainter p(&pixmap_);
+    const QPair<int, QString> key(font_type_, print_buf_);
+    QStaticText* st = text_cache_.object(key);
+    if (st == nullptr) {
+        const uint hash = qHash(key);
+        if (text_seen_.contains(hash)) {
+            st = new QStaticText;
+            prepareStaticText(*st, print_buf_, currentFont());
+            text_cache_.insert(key, st);
+        } else {
+            // It's only a hint, so don't let it grow without bound.
+            if (text_seen_.size() >= 4096) {
+                text_seen_.clear();
+            }
+            text_seen_.insert(hash);
+        }
+    }
 
-    // Manually fill the text background before drawing the text. We need this because
-    // QPainter::drawText() will not fill the whole height of the line.
-    p.save();
-    QPen pen;
-    pen.setColor(Qt::transparent); // workaround for rounded angles (Qt bug?)
-    pen.setCapStyle(Qt::FlatCap);
-    pen.setCosmetic(false);
-    p.setPen(pen);
-    p.setBrush(hugoColorToQt(bg_color_));
-    p.drawRect(flush_pos_x_, flush_pos_y_ + 1, currentFontMetrics().width(print_buf_),
-               currentFontMetrics().lineSpacing());
-    p.restore();
-
-    p.setFont(f);
-    p.setPen(hugoColorToQt(fg_color_));
-    p.drawText(flush_pos_x_, flush_pos_y_ + currentFontMetrics().ascent(), print_buf_);
+    ScreenRun run;
+    run.kind = ScreenRun::Kind::Text;
+    run.pos = QPoint(flush_pos_x_, flush_pos_y_);
+    run.rect = QRect(flush_pos_x_, flush_pos_y_ + 1, currentFontMetrics().width(print_buf_),
+                     currentFontMetrics().lineSpacing());
+    // Glyphs can extend a bit outside their advance width and line spacing (italics, overhangs.)
+    run.clip = run.rect.adjusted(-2, -2, currentFontMetrics().maxWidth() / 2 + 2, 2);
+    run.fg = hugoColorToQt(fg_color_);
+    run.bg = hugoColorToQt(bg_color_);
+    run.font = currentFont();
+    if (st != nullptr) {
+        run.text = *st;
+    } else {
+        run.plain_text = print_buf_;
+    }
     print_buf_.clear();
-    need_screen_update_ = true;
+
+    QPainter p(&pixmap_);
+    ScreenModel::paintRun(p, run);
+    dirty_region_ += run.clip;
+    screen_model_.add(std::move(run));
 }
 
 void HFrame::updateGameScreen(bool force)
 {
     flushText();
-    if (need_screen_update_ or force) {
+    if (force) {
         // qDebug(Q_FUNC_INFO);
         hApp->updateMargins(bg_color_);
-        need_screen_update_ = false;
+        dirty_region_ = QRegion();
         hApp->marginWidget()->update();
         update();
+        return;
+    }
+    if (dirty_region_.isEmpty()) {
+        return;
     }
+    // The margin widget only repaints if its color actually changed.
+    hApp->updateMargins(bg_color_);
+    update(dirty_region_);
+    dirty_region_ = QRegion();
+}
+
+QRect HFrame::inputLineRect() const
+{
+    // From the start of the input to the right edge, since erasing text makes the input shorter.
+    // The cursor is always on the input line.
+    const int x = std::min(input_start_x_, cursor_pos_.x()) - 2;
+    const int h = std::max({font_metrics_.lineSpacing(), font_metrics_.height(),
+                            static_cast<int>(cursor_height_)});
+    return QRect(x, input_start_y_ - 2, width() - x, h + 4);
 }
 
 void HFrame::updateCursorPos()
@@ -707,7 +923,7 @@ void HFrame::updateCursorPos()
     if (not is_blink_visible_) {
         blinkCursor();
     }
-    update();
+    update(inputLineRect());
 }
 
 void HFrame::resetCursorBlinking()
@@ -2,16 +2,28 @@
 #pragma once
 #include <QWidget>
 
+#include <QCache>
+#include <QElapsedTimer>
 #include <QFontMetrics>
 #include <QList>
 #include <QMutex>
-#include <QQueue>
+#include <QPair>
+#include <QRegion>
+#include <QSet>
+#include <QStaticText>
 #include <QWaitCondition>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
 
+#include "fontmetricssnapshot.h"
 #include "happlication.h"
+#include "screenmodel.h"
 
 class HFrame;
 class QMenu;
+class QPainter;
 class QTimer;
 
 extern HFrame* hFrame;
@@ -20,6 +32,17 @@ class HFrame final: public QWidget
 {
     Q_OBJECT
 
+public:
+    // A keypress or mouse click.
+    struct InputEvent
+    {
+        // Hugo key code. 0 means this is a mouse click.
+        char key;
+        Qt::KeyboardModifiers modifiers;
+        // Position of a mouse click.
+        QPoint pos;
+    };
+
 private:
     // These values specify the exact input-mode we are in.
     enum class InputMode
@@ -38,15 +61,21 @@ private:
     // We have a finished user input.
     bool have_input_ready_ = false;
 
-    // Keypress input queue. If an element is 0, it means the input was a mouse click.
-    QQueue<char> key_queue_;
+    // Keypresses and clicks waiting for the engine. We are the only producer and the engine
+    // thread is the only consumer, so checking for input doesn't need a lock. Must be a power of
+    // two.
+    static constexpr size_t INPUT_RING_SIZE = 64;
+    std::array<InputEvent, INPUT_RING_SIZE> input_ring_;
 
-    // Mouse click input queue.
-    QQueue<QPoint> click_queue_;
+    // Next event the engine thread reads. Only written by the engine thread (see startInput() for
+    // the one exception.)
+    std::atomic<size_t> input_head_{0};
 
-    // The keypress and click queues are also accessed from the engine thread.
-    QMutex key_queue_mutex_;
-    QMutex click_queue_mutex_;
+    // Next free slot. Only written by the GUI thread.
+    std::atomic<size_t> input_tail_{0};
+
+    // Only used for waking up the engine thread when it's waiting for input.
+    QMutex input_wait_mutex_;
 
     // Input buffer.
     QString input_buf_;
@@ -75,19 +104,50 @@ private:
     int fg_color_ = 16;
     int bg_color_ = 17;
 
-    // Current font attributes.
-    bool use_fixed_font_ = false;
-    bool use_underline_font_ = false;
-    bool use_italic_font_ = false;
-    bool use_bold_font_ = false;
+    // Current Hugo font type (any combination of BOLD_FONT, ITALIC_FONT, UNDERLINE_FONT and
+    // PROP_FONT.)
+    int font_type_ = 0;
 
     // Current font metrics.
     QFontMetrics font_metrics_{QFont()};
 
+    // All font variants and their metrics, indexed by Hugo font type. Rebuilt by
+    // updateFontMetricsSet().
+    struct FontVariant final
+    {
+        QFont font;
+        QFontMetrics metrics;
+    };
+    std::vector<FontVariant> fonts_;
+
+    // Pre-shaped text of recently printed strings, keyed by font type. Games tend to print the
+    // same strings over and over (status line, prompt, room names.) Most prose is only printed
+    // once though, so a string is only shaped and cached the second time we see it; until then,
+    // text_seen_ just remembers its hash.
+    QCache<QPair<int, QString>, QStaticText> text_cache_{256};
+    QSet<uint> text_seen_;
+
+    // Pre-shaped current input line. Repainted on every cursor blink, so we only lay it out again
+    // when the input or the font changes.
+    QStaticText input_text_;
+
+    // Metrics of all font variants, as seen by the engine thread. The engine keeps track of its
+    // own current font, so it doesn't have to wait for us to switch fonts before measuring text.
+    // Replaced, never modified, when the font settings change. Access only through
+    // std::atomic_load()/std::atomic_store().
+    std::shared_ptr<const FontMetricsSet> metrics_set_;
+
+    // Bumped after each new set is published, so the engine can tell when it needs to fetch a new
+    // one without having to lock anything.
+    std::atomic<int> metrics_generation_{0};
+
     // We render game output into a pixmap first instead or painting directly on the widget. We then
     // draw the pixmap in our paintEvent().
     QPixmap pixmap_{1, 1};
 
+    // What's on pixmap_, as text runs and images. Used to render it again after a resize.
+    ScreenModel screen_model_;
+
     // We buffer text printed with printText() so that we can draw whole strings rather than single
     // characters at a time.
     QString print_buf_;
@@ -118,18 +178,49 @@ private:
     // Text cursor blink timer.
     QTimer* blink_timer_;
 
-    // Keeps track of whether the game screen needs updating.
-    bool need_screen_update_ = false;
+    // Parts of the game screen (in widget coordinates) that changed since the last repaint.
+    QRegion dirty_region_;
+
+    // Updates the game screen at the display's frame rate, if needed.
+    QTimer* screen_update_timer_;
+
+    // Soft scrolling. The pixmap is always scrolled right away; we only paint the scrolled area
+    // lower by an offset that shrinks towards zero on every screen update tick. The strip holds
+    // the rows that were scrolled out of the area and are still visible during the animation.
+    QRect soft_scroll_area_;
+    qreal soft_scroll_offset_ = 0;
+    QPixmap soft_scroll_strip_;
+    QElapsedTimer soft_scroll_clock_;
+
+    // Screen fade (the FADE_SCREEN opcode.) At an alpha of 1.0 there's nothing to do; below that,
+    // paintEvent() blends the screen with the margin color.
+    qreal fade_alpha_ = 1.0;
+    qreal fade_start_alpha_ = 1.0;
+    qreal fade_end_alpha_ = 1.0;
+    int fade_duration_ = 0;
+    bool is_fading_ = false;
+    QElapsedTimer fade_clock_;
 
     // We need a small time delay before minimizing when losing focus while in fullscreen mode.
     QTimer* minimize_timer_;
 
-    // Add a keypress to our input queue.
-    void enqueueKey(char key, QMouseEvent* e);
+    // Add a keypress or click (if 'e' is not null) to our input queue.
+    void enqueueKey(char key, Qt::KeyboardModifiers modifiers, QMouseEvent* e);
 
     // Set the height of the text cursor in pixels.
     void updateCursorShape();
 
+    // Area of the current input line, including the text cursor.
+    QRect inputLineRect() const;
+
+    void startSoftScroll(const QRect& area, int h);
+    void advanceSoftScroll();
+    void stopSoftScroll();
+    void paintSoftScroll(QPainter& p);
+    void paintInputAndCursor(QPainter& p);
+
+    void advanceFade();
+
     // Prevent auto minimize when fullscreen.
     bool prevent_auto_minimize_ = false;
 
@@ -178,13 +269,19 @@ public:
     // Get the most recently entered input line and clear it.
     void getInput(char* buf, size_t buflen);
 
-    // Returns the next character waiting in the queue. If the queue is empty, it will wait for a
-    // character to become available. Note: if this returns 0, it means the next "key" is a mouse
-    // click; call getNextClick() to get the position of the mouse click.
-    int getNextKey();
+    // Engine thread only. Waits until a keypress or click is available.
+    void waitForInputEvent();
+
+    // Engine thread only. Removes and returns the next keypress or click. There must be one (see
+    // hasInputEvent().)
+    InputEvent takeInputEvent();
 
-    QPoint getNextClick();
-    bool hasKeyInQueue();
+    // Engine thread only. Doesn't lock anything, so the engine can poll this as often as it wants.
+    bool hasInputEvent() const
+    {
+        return input_head_.load(std::memory_order_relaxed)
+               != input_tail_.load(std::memory_order_acquire);
+    }
 
     // Clear a region of the window using the current background color.
     void clearRegion(qreal left, qreal top, qreal right, qreal bottom);
@@ -202,6 +299,31 @@ public:
         return font_metrics_;
     }
 
+    const QFont& currentFont() const
+    {
+        return fonts_[font_type_].font;
+    }
+
+    // Fade the screen from 'startAlpha' (or the current alpha, if negative) to 'endAlpha' over
+    // 'duration' milliseconds. Doesn't wait for the fade to finish.
+    void fadeScreen(int duration, qreal startAlpha, qreal endAlpha);
+
+    // Rebuild our font caches and publish new font metrics to the engine if the font settings
+    // changed.
+    void updateFontMetricsSet();
+
+    // Thread-safe. Returns the metrics of all font variants for use by the engine thread.
+    std::shared_ptr<const FontMetricsSet> fontMetricsSet() const
+    {
+        return std::atomic_load(&metrics_set_);
+    }
+
+    // Thread-safe. Changes every time fontMetricsSet() would return a different set.
+    int fontMetricsGeneration() const
+    {
+        return metrics_generation_.load(std::memory_order_acquire);
+    }
+
     // Print text using the current foreground and background colors. The Text is might not be
     // printed immediately; call flushText() to flush the accumulated text to the screen.
     void printText(const QString& str, int x, int y);
@@ -219,6 +341,7 @@ public:
     void setCursorVisible(bool visible)
     {
         is_cursor_visible_ = visible;
+        update(inputLineRect());
     }
 
     bool isCursorVisible() const
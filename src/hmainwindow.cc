@@ -8,10 +8,8 @@
 #include <QLayout>
 #include <QMenuBar>
 #include <QMessageBox>
-#include <QScrollBar>
 #include <QShortcut>
 #include <QTextCodec>
-#include <QTextEdit>
 #include <QWindowStateChangeEvent>
 
 #include "aboutdialog.h"
@@ -389,9 +387,7 @@ void HMainWindow::appendToScrollback(const QByteArray& str)
         return;
     }
 
-    scrollback_window_->moveCursor(QTextCursor::End);
-    scrollback_window_->insertPlainText(hApp->hugoCodec()->toUnicode(str));
-    scrollback_window_->verticalScrollBar()->triggerAction(QScrollBar::SliderToMaximum);
+    scrollback_window_->appendText(hApp->hugoCodec()->toUnicode(str));
 }
 
 void HMainWindow::hideMenuBar()
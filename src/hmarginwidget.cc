@@ -81,6 +81,9 @@ void HMarginWidget::removeWidget(QWidget* w)
 
 void HMarginWidget::setColor(QColor color)
 {
+    if (color == color_) {
+        return;
+    }
     color_ = std::move(color);
     update();
 }
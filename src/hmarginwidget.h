@@ -27,6 +27,11 @@ public:
     void removeWidget(QWidget* w);
     void setColor(QColor color);
 
+    const QColor& color() const
+    {
+        return color_;
+    }
+
 protected:
     void wheelEvent(QWheelEvent* e) override;
     void mouseMoveEvent(QMouseEvent* e) override;
@@ -1,41 +1,423 @@
 // This is copyrighted software. More information is at the end of this file.
 #include "hscrollback.h"
 
+#include <QApplication>
+#include <QClipboard>
+#include <QHBoxLayout>
 #include <QKeyEvent>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPainter>
+#include <QScrollBar>
+#include <QTextLayout>
+#include <QtMath>
+#include <algorithm>
 
 #include "happlication.h"
 #include "hmainwindow.h"
 #include "settings.h"
 
+// Space around the text.
+static constexpr int MARGIN = 4;
+
 HScrollbackWindow::HScrollbackWindow(QWidget* parent)
-    : QTextEdit(parent)
+    : QAbstractScrollArea(parent)
+    , search_bar_(new QWidget(this))
+    , search_edit_(new QLineEdit(search_bar_))
+    , search_status_(new QLabel(search_bar_))
 {
     setWindowTitle(HApplication::applicationName() + ' ' + "Scrollback");
-    setReadOnly(true);
-    setUndoRedoEnabled(false);
-    setTextInteractionFlags(Qt::TextSelectableByMouse);
     setFrameStyle(QFrame::NoFrame | QFrame::Plain);
     setFont(hApp->settings().scrollback_font);
-    // Don't allow the scrollbuffer to grow forever; limit it to fMaximumBlockCount lines.
-    document()->setMaximumBlockCount(max_block_count_);
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    viewport()->setBackgroundRole(QPalette::Base);
+    viewport()->setAutoFillBackground(true);
+    viewport()->setCursor(Qt::IBeamCursor);
     resize(initial_width_, initial_height_);
+
+    auto* layout = new QHBoxLayout(search_bar_);
+    layout->setContentsMargins(MARGIN, MARGIN, MARGIN, MARGIN);
+    layout->addWidget(search_edit_);
+    layout->addWidget(search_status_);
+    search_edit_->setPlaceholderText(tr("Search (Enter for older, Shift+Enter for newer)"));
+    search_edit_->setClearButtonEnabled(true);
+    search_edit_->installEventFilter(this);
+    search_bar_->setBackgroundRole(QPalette::Window);
+    search_bar_->setAutoFillBackground(true);
+    search_bar_->hide();
+    connect(search_edit_, &QLineEdit::textChanged, this, &HScrollbackWindow::runSearch);
+}
+
+void HScrollbackWindow::appendText(const QString& text)
+{
+    QScrollBar* bar = verticalScrollBar();
+    const bool at_bottom = bar->value() == bar->maximum();
+    const quint64 old_first = buffer_.firstLineId();
+    const int old_value = bar->value();
+
+    // The open line might change, so we can't keep its layout.
+    if (buffer_.lastLineOpen()) {
+        layouts_.remove(buffer_.endLineId() - 1);
+    }
+    const quint64 first_new = buffer_.endLineId() - (buffer_.lastLineOpen() ? 1 : 0);
+    buffer_.append(text);
+
+    // Index the lines that are complete now. The open line gets indexed once it's terminated.
+    const quint64 end_complete = buffer_.endLineId() - (buffer_.lastLineOpen() ? 1 : 0);
+    for (quint64 id = std::max(first_new, buffer_.firstLineId()); id < end_complete; ++id) {
+        index_.addLine(id, buffer_.line(id));
+    }
+    if (buffer_.firstLineId() != old_first) {
+        index_.dropLinesBefore(buffer_.firstLineId());
+        trimHits();
+    }
+
+    // Nothing to update while hidden. We do that when we get shown again.
+    if (not isVisible()) {
+        return;
+    }
+    updateScrollBar();
+    if (at_bottom) {
+        bar->setValue(bar->maximum());
+    } else {
+        // Keep showing the same lines, unless they were dropped from the buffer.
+        const auto dropped = static_cast<qint64>(buffer_.firstLineId() - old_first);
+        bar->setValue(static_cast<int>(std::max<qint64>(0, old_value - dropped)));
+    }
+    viewport()->update();
+}
+
+std::shared_ptr<QTextLayout> HScrollbackWindow::layoutForLine(const quint64 id)
+{
+    const int width = viewport()->width() - 2 * MARGIN;
+    if (width != layout_width_) {
+        layouts_.clear();
+        layout_width_ = width;
+    }
+    auto& cached = layouts_[id];
+    if (cached != nullptr) {
+        return cached;
+    }
+
+    auto layout = std::make_shared<QTextLayout>(buffer_.line(id), font());
+    QTextOption opt;
+    opt.setWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
+    layout->setTextOption(opt);
+    layout->setCacheEnabled(true);
+    layout->beginLayout();
+    qreal height = 0;
+    for (QTextLine l = layout->createLine(); l.isValid(); l = layout->createLine()) {
+        l.setLineWidth(std::max(1, width));
+        l.setPosition(QPointF(0, height));
+        height += l.height();
+    }
+    layout->endLayout();
+    cached = layout;
+    return layout;
+}
+
+void HScrollbackWindow::updateScrollBar()
+{
+    // The maximum is the first line of the last screenful. Finding it only needs the layouts of
+    // one screenful of lines, no matter how many there are.
+    const int avail = viewport()->height() - 2 * MARGIN;
+    quint64 first = buffer_.endLineId();
+    int height = 0;
+    while (first > buffer_.firstLineId()) {
+        height += qCeil(layoutForLine(first - 1)->boundingRect().height());
+        if (height > avail and first < buffer_.endLineId()) {
+            break;
+        }
+        --first;
+    }
+    const int line_spacing = std::max(1, fontMetrics().lineSpacing());
+    QScrollBar* bar = verticalScrollBar();
+    bar->setRange(0, static_cast<int>(first - buffer_.firstLineId()));
+    bar->setPageStep(std::max(1, avail / line_spacing - 1));
+    bar->setSingleStep(1);
+
+    // Don't let the layout cache grow without bounds while lines keep getting appended.
+    if (layouts_.size() > 1024) {
+        layouts_.clear();
+    }
+}
+
+void HScrollbackWindow::layoutVisibleLines()
+{
+    visible_.clear();
+    int y = MARGIN;
+    for (quint64 id = buffer_.firstLineId() + verticalScrollBar()->value();
+         id < buffer_.endLineId() and y < viewport()->height(); ++id) {
+        auto layout = layoutForLine(id);
+        visible_.push_back({id, y, layout});
+        y += qCeil(layout->boundingRect().height());
+    }
+}
+
+void HScrollbackWindow::paintEvent(QPaintEvent* /*e*/)
+{
+    layoutVisibleLines();
+
+    const TextPos& sel_start = std::min(sel_anchor_, sel_pos_);
+    const TextPos& sel_end = std::max(sel_anchor_, sel_pos_);
+    QTextLayout::FormatRange sel;
+    sel.format.setBackground(palette().brush(QPalette::Highlight));
+    sel.format.setForeground(palette().brush(QPalette::HighlightedText));
+
+    QPainter p(viewport());
+    p.setPen(palette().color(QPalette::Text));
+    for (const auto& v : visible_) {
+        QVector<QTextLayout::FormatRange> selections;
+        if (sel_start < sel_end and v.id >= sel_start.line and v.id <= sel_end.line) {
+            sel.start = v.id == sel_start.line ? sel_start.col : 0;
+            const int end = v.id == sel_end.line ? sel_end.col : buffer_.line(v.id).length() + 1;
+            sel.length = end - sel.start;
+            selections.append(sel);
+        }
+        v.layout->draw(&p, QPointF(MARGIN, v.y), selections);
+    }
+}
+
+void HScrollbackWindow::resizeEvent(QResizeEvent* e)
+{
+    QAbstractScrollArea::resizeEvent(e);
+    search_bar_->setGeometry(0, 0, width(), search_bar_->sizeHint().height());
+    const bool at_bottom = verticalScrollBar()->value() == verticalScrollBar()->maximum();
+    updateScrollBar();
+    if (at_bottom) {
+        verticalScrollBar()->setValue(verticalScrollBar()->maximum());
+    }
+}
+
+void HScrollbackWindow::showEvent(QShowEvent* e)
+{
+    // Text might have been appended while we were hidden.
+    QAbstractScrollArea::showEvent(e);
+    updateScrollBar();
+    verticalScrollBar()->setValue(verticalScrollBar()->maximum());
+}
+
+void HScrollbackWindow::changeEvent(QEvent* e)
+{
+    QAbstractScrollArea::changeEvent(e);
+    if (e->type() == QEvent::FontChange) {
+        layouts_.clear();
+        updateScrollBar();
+        viewport()->update();
+    }
+}
+
+HScrollbackWindow::TextPos HScrollbackWindow::textPosAt(const QPoint& pos) const
+{
+    if (visible_.empty()) {
+        return TextPos();
+    }
+    if (pos.y() < visible_.front().y) {
+        return {visible_.front().id, 0};
+    }
+    for (const auto& v : visible_) {
+        const QPointF local = pos - QPointF(MARGIN, v.y);
+        for (int i = 0; i < v.layout->lineCount(); ++i) {
+            const QTextLine l = v.layout->lineAt(i);
+            if (local.y() < l.y() + l.height()) {
+                return {v.id, l.xToCursor(local.x())};
+            }
+        }
+    }
+    return {visible_.back().id, buffer_.line(visible_.back().id).length()};
+}
+
+QString HScrollbackWindow::selectedText() const
+{
+    const TextPos start = std::max(std::min(sel_anchor_, sel_pos_),
+                                   TextPos{buffer_.firstLineId(), 0});
+    const TextPos end = std::max(sel_anchor_, sel_pos_);
+    QString text;
+    for (quint64 id = start.line; id <= end.line and id < buffer_.endLineId(); ++id) {
+        const QString& line = buffer_.line(id);
+        const int from = id == start.line ? start.col : 0;
+        const int to = id == end.line ? end.col : line.length();
+        text += line.mid(from, to - from);
+        if (id != end.line) {
+            text += QLatin1Char('\n');
+        }
+    }
+    return text;
+}
+
+void HScrollbackWindow::mousePressEvent(QMouseEvent* e)
+{
+    if (e->button() != Qt::LeftButton) {
+        QAbstractScrollArea::mousePressEvent(e);
+        return;
+    }
+    sel_anchor_ = sel_pos_ = textPosAt(e->pos());
+    is_selecting_ = true;
+    viewport()->update();
+}
+
+void HScrollbackWindow::mouseMoveEvent(QMouseEvent* e)
+{
+    if (not is_selecting_) {
+        QAbstractScrollArea::mouseMoveEvent(e);
+        return;
+    }
+
+    // Scroll when dragging past the top or bottom.
+    if (e->pos().y() < 0) {
+        verticalScrollBar()->triggerAction(QScrollBar::SliderSingleStepSub);
+        layoutVisibleLines();
+    } else if (e->pos().y() > viewport()->height()) {
+        verticalScrollBar()->triggerAction(QScrollBar::SliderSingleStepAdd);
+        layoutVisibleLines();
+    }
+    sel_pos_ = textPosAt(e->pos());
+    viewport()->update();
+}
+
+void HScrollbackWindow::mouseReleaseEvent(QMouseEvent* e)
+{
+    if (not is_selecting_) {
+        QAbstractScrollArea::mouseReleaseEvent(e);
+        return;
+    }
+    is_selecting_ = false;
+    const QString& text = selectedText();
+    if (not text.isEmpty() and QApplication::clipboard()->supportsSelection()) {
+        QApplication::clipboard()->setText(text, QClipboard::Selection);
+    }
+}
+
+void HScrollbackWindow::showSearchBar()
+{
+    const int height = search_bar_->sizeHint().height();
+    search_bar_->setGeometry(0, 0, width(), height);
+    setViewportMargins(0, height, 0, 0);
+    search_bar_->show();
+    search_edit_->setFocus();
+    search_edit_->selectAll();
+}
+
+void HScrollbackWindow::hideSearchBar()
+{
+    search_bar_->hide();
+    setViewportMargins(0, 0, 0, 0);
+    setFocus();
+}
+
+void HScrollbackWindow::runSearch()
+{
+    hits_ = index_.search(search_edit_->text());
+    // The index might not have caught up with lines that were dropped from the buffer yet.
+    current_hit_ = -1;
+    trimHits();
+    if (not hits_.empty()) {
+        // Start with the most recent one.
+        showHit(static_cast<int>(hits_.size()) - 1);
+    }
+}
+
+// Removes the hits on lines that are no longer in the buffer. Returns how many were removed.
+int HScrollbackWindow::trimHits()
+{
+    const auto dropped = static_cast<int>(
+        std::lower_bound(hits_.begin(), hits_.end(), buffer_.firstLineId()) - hits_.begin());
+    hits_.erase(hits_.begin(), hits_.begin() + dropped);
+    if (hits_.empty()) {
+        current_hit_ = -1;
+        search_status_->setText(search_edit_->text().trimmed().isEmpty() ? QString()
+                                                                          : tr("No matches"));
+    } else if (current_hit_ >= 0) {
+        current_hit_ = std::max(0, current_hit_ - dropped);
+        search_status_->setText(tr("%1 of %2").arg(current_hit_ + 1).arg(hits_.size()));
+    }
+    return dropped;
+}
+
+void HScrollbackWindow::showHit(const int index)
+{
+    // Lines might have been dropped since 'index' was picked.
+    const int dropped = trimHits();
+    if (hits_.empty()) {
+        return;
+    }
+    current_hit_ = std::max(0, std::min(index - dropped, static_cast<int>(hits_.size()) - 1));
+    const quint64 id = hits_[current_hit_];
+    search_status_->setText(tr("%1 of %2").arg(current_hit_ + 1).arg(hits_.size()));
+
+    // Select the first search word in the line, or the whole line if we can't find it (it might
+    // only match as a prefix.)
+    const QString& line = buffer_.line(id);
+    const QStringList& words = ScrollbackIndex::words(search_edit_->text());
+    const int col = words.isEmpty() ? -1 : line.indexOf(words.first(), 0, Qt::CaseInsensitive);
+    if (col >= 0) {
+        sel_anchor_ = {id, col};
+        sel_pos_ = {id, col + words.first().length()};
+    } else {
+        sel_anchor_ = {id, 0};
+        sel_pos_ = {id, line.length()};
+    }
+
+    // Put the line in the middle of the viewport.
+    QScrollBar* bar = verticalScrollBar();
+    const auto value = static_cast<qint64>(id - buffer_.firstLineId()) - bar->pageStep() / 2;
+    bar->setValue(static_cast<int>(std::max<qint64>(0, std::min<qint64>(value, bar->maximum()))));
+    viewport()->update();
+}
+
+bool HScrollbackWindow::eventFilter(QObject* watched, QEvent* e)
+{
+    if (watched != search_edit_ or e->type() != QEvent::KeyPress) {
+        return QAbstractScrollArea::eventFilter(watched, e);
+    }
+    auto* ke = static_cast<QKeyEvent*>(e);
+    if (ke->key() == Qt::Key_Escape) {
+        hideSearchBar();
+        return true;
+    }
+    if (ke->key() == Qt::Key_Return or ke->key() == Qt::Key_Enter) {
+        showHit(ke->modifiers() & Qt::ShiftModifier ? current_hit_ + 1 : current_hit_ - 1);
+        return true;
+    }
+    if (ke->key() == Qt::Key_PageUp or ke->key() == Qt::Key_PageDown) {
+        // Let the user look around without leaving the search bar.
+        keyPressEvent(ke);
+        return true;
+    }
+    return QAbstractScrollArea::eventFilter(watched, e);
 }
 
 void HScrollbackWindow::keyPressEvent(QKeyEvent* e)
 {
-    if (e->matches(QKeySequence::Close) or e->key() == Qt::Key_Escape) {
+    if (e->matches(QKeySequence::Find)) {
+        showSearchBar();
+    } else if (e->matches(QKeySequence::FindNext)) {
+        showHit(current_hit_ + 1);
+    } else if (e->matches(QKeySequence::FindPrevious)) {
+        showHit(current_hit_ - 1);
+    } else if (e->matches(QKeySequence::Close) or e->key() == Qt::Key_Escape) {
         close();
         hMainWin->activateWindow();
         hMainWin->raise();
         e->accept();
+    } else if (e->matches(QKeySequence::Copy)) {
+        QApplication::clipboard()->setText(selectedText());
+    } else if (e->matches(QKeySequence::SelectAll) and buffer_.lineCount() > 0) {
+        sel_anchor_ = {buffer_.firstLineId(), 0};
+        sel_pos_ = {buffer_.endLineId() - 1, buffer_.line(buffer_.endLineId() - 1).length()};
+        viewport()->update();
+    } else if (e->matches(QKeySequence::MoveToStartOfDocument)) {
+        verticalScrollBar()->triggerAction(QScrollBar::SliderToMinimum);
+    } else if (e->matches(QKeySequence::MoveToEndOfDocument)) {
+        verticalScrollBar()->triggerAction(QScrollBar::SliderToMaximum);
     } else {
-        QTextEdit::keyPressEvent(e);
+        QAbstractScrollArea::keyPressEvent(e);
     }
 }
 
 void HScrollbackWindow::closeEvent(QCloseEvent* e)
 {
-    QTextEdit::closeEvent(e);
+    QAbstractScrollArea::closeEvent(e);
     hMainWin->hideScrollback();
 }
 
@@ -1,22 +1,100 @@
 // This is copyrighted software. More information is at the end of this file.
 #pragma once
-#include <QTextEdit>
+#include <QAbstractScrollArea>
+#include <QHash>
+#include <memory>
+#include <vector>
 
-class HScrollbackWindow final: public QTextEdit
+#include "scrollbackbuffer.h"
+#include "scrollbackindex.h"
+
+class QLabel;
+class QLineEdit;
+class QTextLayout;
+
+/*
+ * Shows the scrollback. Only the lines that are actually visible get laid out, so opening and
+ * scrolling take the same time no matter how long the scrollback is. The scroll bar counts lines,
+ * not pixels; its value is the index of the top visible line.
+ */
+class HScrollbackWindow final: public QAbstractScrollArea
 {
     Q_OBJECT
 
 public:
     HScrollbackWindow(QWidget* parent = nullptr);
 
+    // Append text to the end. If we were scrolled to the bottom, we stay there.
+    void appendText(const QString& text);
+
 protected:
+    bool eventFilter(QObject* watched, QEvent* e) override;
     void keyPressEvent(QKeyEvent* e) override;
     void closeEvent(QCloseEvent* e) override;
+    void paintEvent(QPaintEvent* e) override;
+    void resizeEvent(QResizeEvent* e) override;
+    void showEvent(QShowEvent* e) override;
+    void changeEvent(QEvent* e) override;
+    void mousePressEvent(QMouseEvent* e) override;
+    void mouseMoveEvent(QMouseEvent* e) override;
+    void mouseReleaseEvent(QMouseEvent* e) override;
 
 private:
-    int max_block_count_ = 7000;
+    // A position in the text, for selections.
+    struct TextPos final
+    {
+        quint64 line = 0;
+        int col = 0;
+
+        bool operator<(const TextPos& other) const
+        {
+            return line < other.line or (line == other.line and col < other.col);
+        }
+    };
+
+    // A line in the viewport, as it was last painted.
+    struct VisibleLine final
+    {
+        quint64 id;
+        int y;
+        std::shared_ptr<QTextLayout> layout;
+    };
+
+    ScrollbackBuffer buffer_;
+    ScrollbackIndex index_;
+
+    // Search bar, shown above the text with QKeySequence::Find.
+    QWidget* search_bar_;
+    QLineEdit* search_edit_;
+    QLabel* search_status_;
+
+    // Lines matching the current search, oldest first, and the one we're showing.
+    std::vector<quint64> hits_;
+    int current_hit_ = -1;
+
+    // Layouts of recently shown lines. Thrown away when the width or the font changes.
+    QHash<quint64, std::shared_ptr<QTextLayout>> layouts_;
+    int layout_width_ = 0;
+
+    std::vector<VisibleLine> visible_;
+
+    TextPos sel_anchor_;
+    TextPos sel_pos_;
+    bool is_selecting_ = false;
+
     int initial_width_ = 600;
     int initial_height_ = 440;
+
+    std::shared_ptr<QTextLayout> layoutForLine(quint64 id);
+    void updateScrollBar();
+    void layoutVisibleLines();
+    TextPos textPosAt(const QPoint& pos) const;
+    QString selectedText() const;
+    void showSearchBar();
+    void hideSearchBar();
+    void runSearch();
+    int trimHits();
+    void showHit(int index);
 };
 
 /* Copyright (C) 2011-2019 Nikos Chantziaras
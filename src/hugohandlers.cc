@@ -3,7 +3,6 @@
 
 #include <QDebug>
 #include <QFileDialog>
-#include <QTextCodec>
 #include <QTextLayout>
 #include <QTextStream>
 #include <QWindow>
@@ -69,39 +68,16 @@ void HugoHandlers::getfilename(char* a, char* b)
     qstrcpy(line, fname.toLocal8Bit().constData());
 }
 
-void HugoHandlers::startGetline(char* p)
+void HugoHandlers::startGetline(const int x, const int y)
 {
-    // Print the prompt in normal text colors.
-    settextcolor(fcolor);
-    setbackcolor(bgcolor);
-    print(p);
-
-    // Switch to input color.
-    settextcolor(icolor);
-
     hFrame->setCursorVisible(true);
-    hFrame->moveCursorPos(QPoint(current_text_x, current_text_y));
-    hFrame->startInput(current_text_x, current_text_y);
+    hFrame->moveCursorPos(QPoint(x, y));
+    hFrame->startInput(x, y);
 }
 
 void HugoHandlers::endGetline()
 {
     hFrame->setCursorVisible(false);
-    char newline[] = "\r\n";
-    print(newline);
-    hFrame->updateGameScreen(false);
-}
-
-void HugoHandlers::clearfullscreen()
-{
-    hFrame->clearRegion(0, 0, 0, 0);
-}
-
-void HugoHandlers::clearwindow()
-{
-    hFrame->setBgColor(bgcolor);
-    hFrame->clearRegion(physical_windowleft, physical_windowtop, physical_windowright,
-                        physical_windowbottom);
 }
 
 void HugoHandlers::settextmode()
@@ -114,7 +90,7 @@ void HugoHandlers::settextmode()
     settextwindow(1, 1, SCREENWIDTH / FIXEDCHARWIDTH, SCREENHEIGHT / FIXEDLINEHEIGHT);
 }
 
-void HugoHandlers::settextwindow(int left, int top, int right, int bottom)
+void HugoHandlers::calcTextWindow(int left, int top, int right, int bottom)
 {
     // qDebug() << "settextwindow" << left << top << right << bottom;
     /* Must be set: */
@@ -125,105 +101,26 @@ void HugoHandlers::settextwindow(int left, int top, int right, int bottom)
 
     // Correct for full-width windows where the right border would otherwise be clipped to a
     // multiple of charwidth, leaving a sliver of the former window at the righthand side.
+    // SCREENWIDTH/SCREENHEIGHT are the frame's size as of the last settextmode().
     if (right >= SCREENWIDTH / FIXEDCHARWIDTH) {
-        physical_windowright = hFrame->width() - 1;
+        physical_windowright = SCREENWIDTH - 1;
     }
     if (bottom >= SCREENHEIGHT / FIXEDLINEHEIGHT) {
-        physical_windowbottom = hFrame->height() - 1;
+        physical_windowbottom = SCREENHEIGHT - 1;
     }
 
     physical_windowwidth = physical_windowright - physical_windowleft + 1;
     physical_windowheight = physical_windowbottom - physical_windowtop + 1;
+}
 
+void HugoHandlers::settextwindow(int left, int top, int right, int bottom)
+{
+    calcTextWindow(left, top, right, bottom);
     hFrame->setFgColor(fcolor);
     hFrame->setBgColor(bgcolor);
     hFrame->setFontType(currentfont);
 }
 
-void HugoHandlers::printFatalError(char* a)
-{
-    print(a);
-}
-
-void HugoHandlers::print(char* a)
-{
-    uint len = qstrlen(a);
-    QString ac;
-
-    for (uint i = 0; i < len; ++i) {
-        // If we've passed the bottom of the window, align to the bottom edge.
-        if (current_text_y > physical_windowbottom - lineheight) {
-            int temp_lh = lineheight;
-            lineheight = current_text_y - physical_windowbottom + lineheight;
-            current_text_y -= lineheight;
-            if (inwindow) {
-                --lineheight;
-            }
-            hFrame->scrollUp(physical_windowleft, physical_windowtop, physical_windowright,
-                             physical_windowbottom, lineheight);
-            TB_Scroll();
-            lineheight = temp_lh;
-        }
-
-        switch (a[i]) {
-        case '\n':
-            hFrame->flushText();
-            current_text_y += lineheight;
-            // last_was_italic = false;
-            break;
-
-        case '\r':
-            hFrame->flushText();
-            if (!inwindow) {
-                current_text_x = physical_windowleft - FIXEDCHARWIDTH;
-            } else {
-                current_text_x = 0;
-            }
-            current_text_x = physical_windowleft;
-            // last_was_italic = false;
-            break;
-
-        default: {
-            ac += hApp->hugoCodec()->toUnicode(a + i, 1);
-        }
-        }
-    }
-
-    hFrame->printText(ac, current_text_x, current_text_y);
-    current_text_x += hFrame->currentFontMetrics().width(ac);
-
-    // Check again after printing.
-    if (current_text_y > physical_windowbottom - lineheight) {
-        int temp_lh = lineheight;
-        lineheight = current_text_y - physical_windowbottom + lineheight;
-        current_text_y -= lineheight;
-        if (inwindow) {
-            --lineheight;
-        }
-        hFrame->scrollUp(physical_windowleft, physical_windowtop, physical_windowright,
-                         physical_windowbottom, lineheight);
-        TB_Scroll();
-        lineheight = temp_lh;
-    }
-}
-
-void HugoHandlers::font(int f)
-{
-    hFrame->setFontType(f);
-    ::charwidth = hFrame->currentFontMetrics().averageCharWidth();
-    lineheight = hFrame->currentFontMetrics().lineSpacing();
-}
-
-void HugoHandlers::settextcolor(int c)
-{
-    hFrame->setFgColor(c);
-}
-
-void HugoHandlers::setbackcolor(int c)
-{
-    hFrame->setBgColor(c);
-}
-
 // FIXME: Check for errors when loading images.
 void HugoHandlers::displaypicture(HUGO_FILE infile, long len, int* result)
 {
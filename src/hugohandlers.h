@@ -13,18 +13,13 @@ extern "C" {
 namespace HugoHandlers {
 
 void calcFontDimensions();
+// Only sets the physical_window* engine globals, so it can also be called from the engine thread.
+void calcTextWindow(int left, int top, int right, int bottom);
 void getfilename(char* a, char* b);
-void startGetline(char* p);
+void startGetline(int x, int y);
 void endGetline();
-void clearfullscreen();
-void clearwindow();
 void settextmode();
 void settextwindow(int left, int top, int right, int bottom);
-void printFatalError(char* a);
-void print(char* a);
-void font(int f);
-void settextcolor(int c);
-void setbackcolor(int c);
 void displaypicture(HUGO_FILE infile, long len, int* result);
 void playmusic(HUGO_FILE infile, long reslength, char loop_flag, int* result);
 void musicvolume(int vol);
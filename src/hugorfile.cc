@@ -1,6 +1,406 @@
 // This is copyrighted software. More information is at the end of this file.
 #include "hugorfile.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <sys/stat.h>
+#include <thread>
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+using Contents = std::shared_ptr<const std::vector<unsigned char>>;
+
+// Writes 'contents' to 'path' so that the file on disk always holds either the old or the new
+// contents, even if we crash half-way.
+bool writeFileAtomically(const std::string& path, const std::vector<unsigned char>& contents)
+{
+    // Data file names have no extension, so this can't clash with another data file.
+    const std::string tmp_path = path + ".tmp";
+    FILE* f = std::fopen(tmp_path.c_str(), "wb");
+    if (f == nullptr) {
+        return false;
+    }
+    bool ok = std::fwrite(contents.data(), 1, contents.size(), f) == contents.size()
+              and std::fflush(f) == 0;
+#ifdef _WIN32
+    ok = ok and _commit(_fileno(f)) == 0;
+#else
+    ok = ok and fsync(fileno(f)) == 0;
+#endif
+    ok = std::fclose(f) == 0 and ok;
+#ifdef _WIN32
+    ok = ok
+         and MoveFileExA(tmp_path.c_str(), path.c_str(),
+                         MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    ok = ok and std::rename(tmp_path.c_str(), path.c_str()) == 0;
+#endif
+    if (not ok) {
+        std::remove(tmp_path.c_str());
+    }
+    return ok;
+}
+
+class DataFileStore final
+{
+public:
+    ~DataFileStore()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            quit_ = true;
+        }
+        wake_.notify_one();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    bool read(const std::string& path, std::vector<unsigned char>& out)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& entry = files_[path];
+
+        // Unless our own copy is newer, pick up changes made to the file by someone else.
+        if (entry.contents != nullptr and not entry.dirty and not entry.writing
+            and not entry.stamp.matches(path)) {
+            entry.contents = nullptr;
+        }
+        if (entry.contents == nullptr) {
+            const Stamp stamp = Stamp::of(path);
+            FILE* f = std::fopen(path.c_str(), "rb");
+            if (f == nullptr) {
+                return false;
+            }
+            std::vector<unsigned char> data;
+            unsigned char buf[4096];
+            size_t len;
+            while ((len = std::fread(buf, 1, sizeof(buf), f)) > 0) {
+                data.insert(data.end(), buf, buf + len);
+            }
+            const bool ok = std::ferror(f) == 0;
+            std::fclose(f);
+            if (not ok) {
+                return false;
+            }
+            entry.contents = std::make_shared<const std::vector<unsigned char>>(std::move(data));
+            entry.stamp = stamp;
+        }
+        out = *entry.contents;
+        return true;
+    }
+
+    // Makes sure we'll be able to write the file later, so that the game gets an error right away
+    // if we can't. Like opening with "wb" would, this creates the file if it doesn't exist yet.
+    bool prepareWrite(const std::string& path)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& entry = files_[path];
+        // The game gets to hear about the last write having failed (once) by this one failing too.
+        if (entry.write_failed) {
+            entry.write_failed = false;
+            return false;
+        }
+        if (entry.writable) {
+            return true;
+        }
+        FILE* f = std::fopen(path.c_str(), "ab");
+        if (f == nullptr) {
+            return false;
+        }
+        std::fclose(f);
+        entry.writable = true;
+        return true;
+    }
+
+    void commit(const std::string& path, std::vector<unsigned char> contents)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto& entry = files_[path];
+            entry.contents = std::make_shared<const std::vector<unsigned char>>(std::move(contents));
+            entry.dirty = true;
+            ++dirty_count_;
+            if (not thread_.joinable()) {
+                thread_ = std::thread(&DataFileStore::run, this);
+            }
+        }
+        wake_.notify_one();
+    }
+
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (dirty_count_ == 0 and writing_ == 0) {
+            return;
+        }
+        ++flush_requests_;
+        wake_.notify_one();
+        idle_.wait(lock, [this] { return dirty_count_ == 0 and writing_ == 0; });
+        --flush_requests_;
+    }
+
+private:
+    // What the file on disk looked like when we last read or wrote it.
+    struct Stamp
+    {
+        bool exists = false;
+        long long size = 0;
+        long long mtime = 0;
+
+        static Stamp of(const std::string& path)
+        {
+            Stamp stamp;
+            struct stat st;
+            if (stat(path.c_str(), &st) == 0) {
+                stamp.exists = true;
+                stamp.size = static_cast<long long>(st.st_size);
+                stamp.mtime = static_cast<long long>(st.st_mtime);
+            }
+            return stamp;
+        }
+
+        bool matches(const std::string& path) const
+        {
+            const Stamp now = of(path);
+            return now.exists == exists and now.size == size and now.mtime == mtime;
+        }
+    };
+
+    struct Entry
+    {
+        Contents contents; // null if not loaded yet
+        Stamp stamp;
+        bool dirty = false;
+        bool writing = false;
+        bool writable = false;
+        bool write_failed = false;
+    };
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            wake_.wait(lock, [this] { return quit_ or dirty_count_ > 0; });
+            if (dirty_count_ == 0) {
+                break;
+            }
+            // Games often write the same file several times in a row. Give them a moment, so we
+            // only write the last version.
+            wake_.wait_for(lock, std::chrono::milliseconds(100),
+                           [this] { return quit_ or flush_requests_ > 0; });
+
+            std::vector<std::pair<std::string, Contents>> pending;
+            for (auto& i : files_) {
+                if (i.second.dirty) {
+                    pending.emplace_back(i.first, i.second.contents);
+                    i.second.dirty = false;
+                    i.second.writing = true;
+                }
+            }
+            dirty_count_ = 0;
+            writing_ = static_cast<int>(pending.size());
+
+            lock.unlock();
+            std::vector<std::pair<bool, Stamp>> results;
+            for (const auto& i : pending) {
+                const bool ok = writeFileAtomically(i.first, *i.second);
+                if (not ok) {
+                    std::fprintf(stderr, "Could not write data file \"%s\": %s\n",
+                                 i.first.c_str(), std::strerror(errno));
+                }
+                results.emplace_back(ok, Stamp::of(i.first));
+            }
+            lock.lock();
+            for (size_t i = 0; i < pending.size(); ++i) {
+                auto& entry = files_[pending[i].first];
+                entry.writing = false;
+                if (entry.dirty) {
+                    // Written to again in the meantime; the next round takes care of it.
+                    continue;
+                }
+                if (results[i].first) {
+                    entry.stamp = results[i].second;
+                } else {
+                    // Whatever is on disk is what the game should read from now on.
+                    entry.contents = nullptr;
+                    entry.write_failed = true;
+                }
+            }
+            writing_ = 0;
+            idle_.notify_all();
+        }
+        idle_.notify_all();
+    }
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    std::map<std::string, Entry> files_;
+    std::thread thread_;
+    int dirty_count_ = 0;
+    int writing_ = 0;
+    int flush_requests_ = 0;
+    bool quit_ = false;
+};
+
+DataFileStore& dataFileStore()
+{
+    static DataFileStore store;
+    return store;
+}
+
+} // namespace
+
+HugorFile::HugorFile(std::string path, std::vector<unsigned char> contents, bool writable)
+    : handle_(nullptr)
+    , in_memory_(true)
+    , writable_(writable)
+    , path_(std::move(path))
+    , data_(std::move(contents))
+{}
+
+int HugorFile::close()
+{
+    if (in_memory_) {
+        in_memory_ = false;
+        if (writable_ and not error_) {
+            dataFileStore().commit(path_, std::move(data_));
+        }
+        data_.clear();
+        return error_ ? EOF : 0;
+    }
+    if (handle_ == nullptr) {
+        return 0;
+    }
+    auto ret = std::fclose(handle_);
+    handle_ = nullptr;
+    return ret;
+}
+
+void HugorFile::discard()
+{
+    if (in_memory_) {
+        in_memory_ = false;
+        data_.clear();
+        return;
+    }
+    close();
+}
+
+int HugorFile::getc()
+{
+    if (not in_memory_) {
+        return std::fgetc(handle_);
+    }
+    if (pos_ >= data_.size()) {
+        return EOF;
+    }
+    return data_[pos_++];
+}
+
+int HugorFile::putc(const int c)
+{
+    if (not in_memory_) {
+        return std::fputc(c, handle_);
+    }
+    if (not writable_ or error_) {
+        error_ = true;
+        return EOF;
+    }
+    if (pos_ >= data_.size()) {
+        try {
+            data_.resize(pos_ + 1);
+        } catch (const std::bad_alloc&) {
+            error_ = true;
+            return EOF;
+        }
+    }
+    data_[pos_++] = static_cast<unsigned char>(c);
+    return static_cast<unsigned char>(c);
+}
+
+int HugorFile::seek(const long offset, const int whence)
+{
+    if (not in_memory_) {
+        return std::fseek(handle_, offset, whence);
+    }
+    long base = 0;
+    if (whence == SEEK_CUR) {
+        base = static_cast<long>(pos_);
+    } else if (whence == SEEK_END) {
+        base = static_cast<long>(data_.size());
+    }
+    if (base + offset < 0) {
+        return -1;
+    }
+    pos_ = static_cast<size_t>(base + offset);
+    return 0;
+}
+
+long HugorFile::tell()
+{
+    if (not in_memory_) {
+        return std::ftell(handle_);
+    }
+    return static_cast<long>(pos_);
+}
+
+size_t HugorFile::read(void* const ptr, const size_t size, const size_t nmemb)
+{
+    if (not in_memory_) {
+        return std::fread(ptr, size, nmemb, handle_);
+    }
+    if (size == 0 or pos_ >= data_.size()) {
+        return 0;
+    }
+    const size_t count = std::min(nmemb, (data_.size() - pos_) / size);
+    std::memcpy(ptr, data_.data() + pos_, count * size);
+    pos_ += count * size;
+    return count;
+}
+
+int HugorFile::error()
+{
+    if (not in_memory_) {
+        return std::ferror(handle_);
+    }
+    return error_ ? 1 : 0;
+}
+
+HugorFile* openDataFile(const char* const path, const char* const mode)
+{
+    if (mode[0] == 'w') {
+        if (not dataFileStore().prepareWrite(path)) {
+            return nullptr;
+        }
+        return new HugorFile(path, {}, true);
+    }
+    std::vector<unsigned char> contents;
+    if (not dataFileStore().read(path, contents)) {
+        return nullptr;
+    }
+    return new HugorFile(path, std::move(contents), false);
+}
+
+void flushDataFiles()
+{
+    dataFileStore().flush();
+}
+
 /* Copyright (C) 2011-2019 Nikos Chantziaras
  *
  * This file is part of Hugor.
@@ -1,6 +1,8 @@
 // This is copyrighted software. More information is at the end of this file.
 #pragma once
 #include <cstdio>
+#include <string>
+#include <vector>
 
 struct HugorFile final
 {
@@ -9,9 +11,14 @@ public:
         : handle_(handle)
     {}
 
-    ~HugorFile() noexcept
+    // In-memory file from the data file store (see openDataFile().) If 'writable' is set, the
+    // contents are handed back to the store by close() and written to 'path' in the background.
+    HugorFile(std::string path, std::vector<unsigned char> contents, bool writable);
+
+    // A file that's still open when it's destroyed wasn't finished, so its contents aren't kept.
+    ~HugorFile()
     {
-        close();
+        discard();
     }
 
     HugorFile(const HugorFile&) = delete;
@@ -29,20 +36,50 @@ public:
         return tmp;
     }
 
-    int close() noexcept
+    bool isInMemory() const noexcept
     {
-        if (handle_ == nullptr) {
-            return 0;
-        }
-        auto ret = std::fclose(handle_);
-        handle_ = nullptr;
-        return ret;
+        return in_memory_;
     }
 
+    // For an in-memory file opened for writing, this is where its contents are handed to the
+    // store, unless writing to it failed. Returns EOF in that case.
+    int close();
+
+    // Closes the file, dropping whatever was written to an in-memory file. The file on disk stays
+    // as it was.
+    void discard();
+
+    // stdio equivalents that also work for in-memory files.
+    int getc();
+    int putc(int c);
+    int seek(long offset, int whence);
+    long tell();
+    size_t read(void* ptr, size_t size, size_t nmemb);
+    int error();
+
 private:
     FILE* handle_;
+    bool in_memory_ = false;
+    bool writable_ = false;
+    bool error_ = false;
+    std::string path_;
+    std::vector<unsigned char> data_;
+    size_t pos_ = 0;
 };
 
+// Opens a "readfile"/"writefile" data file. These are small and games tend to read and write them
+// repeatedly, so their contents are kept in memory. Reading a file only touches the disk the first
+// time, and after that whenever its size or modification time shows that something else changed it
+// (a change that keeps the size within the same second goes unnoticed). Writing one only checks
+// that the file can be created; the contents are written when the file is closed, by a background
+// thread, to a temporary file that then replaces the original. If that fails, the error is printed,
+// reading the file goes back to the disk, and the next attempt to write the file fails, so that the
+// game finds out. 'mode' is "rb" or "wb". Returns null if the file can't be opened.
+HugorFile* openDataFile(const char* path, const char* mode);
+
+// Waits until all data files written so far are on disk. Called on exit.
+void flushDataFiles();
+
 /* Copyright (C) 2011-2019 Nikos Chantziaras
  *
  * This file is part of Hugor.
@@ -6,11 +6,14 @@
 #include <QDebug>
 #include <QDesktopServices>
 #include <QDir>
-#include <QGraphicsOpacityEffect>
+#include <QElapsedTimer>
 #include <QMetaEnum>
-#include <QPropertyAnimation>
+#include <QThread>
 #include <QUrl>
+#include <algorithm>
+#include <vector>
 
+#include "displayqueue.h"
 #include "extcolors.h"
 #include "happlication.h"
 extern "C" {
@@ -39,6 +42,54 @@ static void clearQueue(std::queue<int>& q)
     std::swap(q, empty);
 }
 
+// Finds the elements [start, start + count) of the Hugo array 'arr' in the array table. The range
+// is clipped to the length of the array. Returns the number of elements in the clipped range and
+// stores the address of the first one in 'addr'.
+static int arrayRange(const int arr, const int start, int count, unsigned int& addr)
+{
+    // Arrays without a length word (game versions before 2.3) can't be checked.
+    if (game_version < 23) {
+        return 0;
+    }
+
+    const long tableSize = static_cast<long>(dicttable - arraytable) * 16;
+    const long base = static_cast<long>(arr) * 2;
+    if (base + 2 > tableSize) {
+        return 0;
+    }
+    defseg = arraytable;
+    const int len = PeekWord(base);
+    defseg = gameseg;
+
+    count = std::min({count, len - start, static_cast<int>((tableSize - base - 2) / 2) - start});
+    addr = base + 2 + start * 2;
+    return std::max(count, 0);
+}
+
+// Reads 'count' array table words starting at 'addr'.
+static std::vector<unsigned int> readArray(const unsigned int addr, const int count)
+{
+    std::vector<unsigned int> vals(count);
+    defseg = arraytable;
+    for (int i = 0; i < count; ++i) {
+        vals[i] = PeekWord(addr + i * 2);
+    }
+    defseg = gameseg;
+    return vals;
+}
+
+// Writes 'vals' to the array table starting at 'addr' as a single undo operation.
+static void writeArray(const unsigned int addr, const std::vector<unsigned int>& vals)
+{
+    const int count = vals.size();
+    SaveUndoArray(addr, count);
+    defseg = arraytable;
+    for (int i = 0; i < count; ++i) {
+        PokeWord(addr + i * 2, vals[i]);
+    }
+    defseg = gameseg;
+}
+
 OpcodeParser::Opcode OpcodeParser::popOpcode()
 {
     return static_cast<Opcode>(popValue());
@@ -151,38 +202,20 @@ void OpcodeParser::parse()
         startAlpha = std::max(-1, std::min(startAlpha, 255));
         endAlpha = std::max(0, std::min(endAlpha, 255));
 
-        runInMainThread([duration, startAlpha, endAlpha, block] {
-            qreal startF = (qreal)startAlpha / 255;
-            qreal endF = (qreal)endAlpha / 255;
-
-            static QGraphicsOpacityEffect* eff = nullptr;
-            static QPropertyAnimation* fadeAnim = nullptr;
-            static QEventLoop* idle = nullptr;
-            if (eff == nullptr) {
-                eff = new QGraphicsOpacityEffect(hApp->frameWindow());
-                fadeAnim = new QPropertyAnimation(eff, "opacity", eff);
-                idle = new QEventLoop(fadeAnim);
-                hApp->frameWindow()->setGraphicsEffect(eff);
-                QObject::connect(fadeAnim, &QPropertyAnimation::finished, idle,
-                                 [] { idle->exit(); });
-            }
+        runInMainThreadAfterQueue([duration, startAlpha, endAlpha] {
+            hFrame->fadeScreen(duration, startAlpha < 0 ? -1.0 : (qreal)startAlpha / 255,
+                               (qreal)endAlpha / 255);
+        });
 
-            fadeAnim->stop();
-            fadeAnim->setDuration(duration);
-            if (startAlpha >= 0) {
-                fadeAnim->setStartValue(startF);
-            } else {
-                fadeAnim->setStartValue(eff->opacity());
-            }
-            fadeAnim->setEndValue(endF);
-            fadeAnim->setEasingCurve(QEasingCurve::OutQuad);
-            if (block) {
-                fadeAnim->start();
-                idle->exec();
-            } else {
-                fadeAnim->start();
+        // The GUI animates the fade on its own. If the game wants to wait for it, we wait here in
+        // the engine thread.
+        if (block) {
+            QElapsedTimer timer;
+            timer.start();
+            while (timer.elapsed() < duration and not hApp->engineQuitRequested()) {
+                QThread::msleep(10);
             }
-        });
+        }
 
         pushOutput(OpcodeResult::OK);
         break;
@@ -194,7 +227,7 @@ void OpcodeParser::parse()
             break;
         }
         auto url = GetWord(popValue());
-        runInMainThread([url] {
+        runInMainThreadAfterQueue([url] {
             QDesktopServices::openUrl(
                 QUrl::fromUserInput(url, QDir::currentPath(), QUrl::AssumeLocalFile));
         });
@@ -208,7 +241,7 @@ void OpcodeParser::parse()
             break;
         }
         bool f = popValue();
-        runInMainThread([f] { hMainWin->setFullscreen(f); });
+        runInMainThreadAfterQueue([f] { hMainWin->setFullscreen(f); });
         pushOutput(OpcodeResult::OK);
         break;
     }
@@ -219,7 +252,7 @@ void OpcodeParser::parse()
             break;
         }
         auto text = GetWord(popValue());
-        runInMainThread([text] { QApplication::clipboard()->setText(text); });
+        runInMainThreadAfterQueue([text] { QApplication::clipboard()->setText(text); });
         pushOutput(OpcodeResult::OK);
         break;
     }
@@ -230,7 +263,7 @@ void OpcodeParser::parse()
             break;
         }
         bool res;
-        runInMainThread([&res] { res = isMusicPlaying(); });
+        runInMainThreadAfterQueue([&res] { res = isMusicPlaying(); });
         pushOutput(OpcodeResult::OK);
         pushOutput(res);
         break;
@@ -242,7 +275,7 @@ void OpcodeParser::parse()
             break;
         }
         bool res;
-        runInMainThread([&res] { res = isSamplePlaying(); });
+        runInMainThreadAfterQueue([&res] { res = isSamplePlaying(); });
         pushOutput(OpcodeResult::OK);
         pushOutput(res);
         break;
@@ -279,7 +312,7 @@ void OpcodeParser::parse()
             break;
         }
         bool res;
-        runInMainThread([&res] { res = hMainWin->isFullScreen(); });
+        runInMainThreadAfterQueue([&res] { res = hMainWin->isFullScreen(); });
         pushOutput(OpcodeResult::OK);
         pushOutput(res);
         break;
@@ -339,6 +372,112 @@ void OpcodeParser::parse()
         break;
     }
 
+    case Opcode::ARRAY_FILL: {
+        if (paramCount != 4) {
+            pushOutput(OpcodeResult::WRONG_PARAM_COUNT);
+            break;
+        }
+        auto arr = popValue();
+        auto start = popValue();
+        auto count = popValue();
+        auto val = static_cast<unsigned int>(popValue());
+        unsigned int addr;
+        count = arrayRange(arr, start, count, addr);
+        writeArray(addr, std::vector<unsigned int>(count, val));
+        pushOutput(OpcodeResult::OK);
+        pushOutput(count);
+        break;
+    }
+
+    case Opcode::ARRAY_COPY: {
+        if (paramCount != 5) {
+            pushOutput(OpcodeResult::WRONG_PARAM_COUNT);
+            break;
+        }
+        auto dst = popValue();
+        auto dstStart = popValue();
+        auto src = popValue();
+        auto srcStart = popValue();
+        auto count = popValue();
+        unsigned int dstAddr;
+        unsigned int srcAddr;
+        count = std::min(arrayRange(dst, dstStart, count, dstAddr),
+                         arrayRange(src, srcStart, count, srcAddr));
+        // Reading the whole source range first makes overlapping copies safe.
+        writeArray(dstAddr, readArray(srcAddr, count));
+        pushOutput(OpcodeResult::OK);
+        pushOutput(count);
+        break;
+    }
+
+    case Opcode::ARRAY_FIND:
+    case Opcode::ARRAY_COUNT: {
+        if (paramCount != 4) {
+            pushOutput(OpcodeResult::WRONG_PARAM_COUNT);
+            break;
+        }
+        auto arr = popValue();
+        auto start = popValue();
+        auto count = popValue();
+        auto val = static_cast<unsigned int>(popValue());
+        unsigned int addr;
+        count = arrayRange(arr, start, count, addr);
+        const auto& vals = readArray(addr, count);
+        pushOutput(OpcodeResult::OK);
+        if (opcode == Opcode::ARRAY_FIND) {
+            // Index of the first match relative to the start of the array, or -1.
+            auto it = std::find(vals.begin(), vals.end(), val);
+            pushOutput(it == vals.end() ? -1 : start + static_cast<int>(it - vals.begin()));
+        } else {
+            pushOutput(static_cast<int>(std::count(vals.begin(), vals.end(), val)));
+        }
+        break;
+    }
+
+    case Opcode::ARRAY_SORT: {
+        if (paramCount != 4) {
+            pushOutput(OpcodeResult::WRONG_PARAM_COUNT);
+            break;
+        }
+        auto arr = popValue();
+        auto start = popValue();
+        auto count = popValue();
+        bool descending = popValue();
+        unsigned int addr;
+        count = arrayRange(arr, start, count, addr);
+        auto vals = readArray(addr, count);
+        // Hugo values are signed 16-bit integers.
+        std::stable_sort(vals.begin(), vals.end(), [descending](unsigned int a, unsigned int b) {
+            return descending ? static_cast<std::int16_t>(a) > static_cast<std::int16_t>(b)
+                              : static_cast<std::int16_t>(a) < static_cast<std::int16_t>(b);
+        });
+        writeArray(addr, vals);
+        pushOutput(OpcodeResult::OK);
+        pushOutput(count);
+        break;
+    }
+
+    case Opcode::NEXT_OBJECT_WITH_ATTRIBUTES: {
+        // The object to search after, followed by up to 8 attributes. 128 is added to attributes
+        // the object must not have.
+        if (paramCount < 2 or paramCount > 9) {
+            pushOutput(OpcodeResult::WRONG_PARAM_COUNT);
+            break;
+        }
+        auto obj = static_cast<std::int16_t>(popValue());
+        int attrs[8];
+        char nattrs[8];
+        const int n = paramCount - 1;
+        for (int i = 0; i < n; ++i) {
+            auto attr = popValue();
+            nattrs[i] = attr >= MAXATTRIBUTES;
+            attrs[i] = nattrs[i] ? attr - MAXATTRIBUTES : attr;
+        }
+        pushOutput(OpcodeResult::OK);
+        pushOutput(NextWithAttributes(obj, n, attrs, nattrs));
+        break;
+    }
+
     default:
         qWarning() << "Unrecognized opcode:" << (int)opcode;
         pushOutput(OpcodeResult::UNKNOWN_OPCODE);
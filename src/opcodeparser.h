@@ -37,6 +37,12 @@ public:
         TOP_JUSTIFIED = 1400,
         SCREENREADER_CAPABLE = 1500,
         CHECK_RESOURCE = 1600,
+        ARRAY_FILL = 1700,
+        ARRAY_COPY = 1800,
+        ARRAY_FIND = 1900,
+        ARRAY_COUNT = 2000,
+        ARRAY_SORT = 2100,
+        NEXT_OBJECT_WITH_ATTRIBUTES = 2200,
     };
 
     enum class OpcodeResult : std::int16_t
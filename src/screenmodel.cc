@@ -0,0 +1,103 @@
+// This is copyrighted software. More information is at the end of this file.
+#include "screenmodel.h"
+
+#include <QPainter>
+#include <algorithm>
+#include <iterator>
+
+void ScreenModel::add(ScreenRun run)
+{
+    // Images with transparency don't hide what's below them.
+    if (run.kind != ScreenRun::Kind::Image or not run.image.hasAlphaChannel()) {
+        const QRegion covered(run.rect);
+        for (auto& r : runs_) {
+            if (r.clip.boundingRect().intersects(run.rect)) {
+                r.clip -= covered;
+            }
+        }
+        dropHiddenRuns();
+    }
+    runs_.push_back(std::move(run));
+}
+
+void ScreenModel::scroll(const QRect& area, const int dy)
+{
+    // Runs that are partly inside the area get split in two; the part inside moves, the part
+    // outside stays. Moved parts can't overlap with what stayed, so appending them keeps the
+    // painting order correct.
+    std::vector<ScreenRun> moved;
+    for (auto& r : runs_) {
+        if (not r.clip.intersects(area)) {
+            continue;
+        }
+        ScreenRun inside = r;
+        inside.clip = (r.clip & area).translated(0, -dy) & area;
+        inside.rect.translate(0, -dy);
+        inside.pos.ry() -= dy;
+        r.clip -= area;
+        if (not inside.clip.isEmpty()) {
+            moved.push_back(std::move(inside));
+        }
+    }
+    dropHiddenRuns();
+    std::move(moved.begin(), moved.end(), std::back_inserter(runs_));
+}
+
+void ScreenModel::paint(QPainter& p) const
+{
+    for (const auto& r : runs_) {
+        paintRun(p, r);
+    }
+}
+
+void ScreenModel::paintRun(QPainter& p, const ScreenRun& run)
+{
+    p.save();
+    p.setClipRegion(run.clip);
+    switch (run.kind) {
+    case ScreenRun::Kind::Fill:
+        p.fillRect(run.rect, run.bg);
+        break;
+    case ScreenRun::Kind::Text:
+        // Drawing the text itself will not fill the whole height of the line.
+        p.fillRect(run.rect, run.bg);
+        p.setFont(run.font);
+        p.setPen(run.fg);
+        if (run.plain_text.isEmpty()) {
+            p.drawStaticText(run.pos, run.text);
+        } else {
+            // Unlike drawStaticText(), this takes the baseline.
+            p.drawText(run.pos + QPoint(0, p.fontMetrics().ascent()), run.plain_text);
+        }
+        break;
+    case ScreenRun::Kind::Image:
+        p.drawImage(run.pos, run.image);
+        break;
+    }
+    p.restore();
+}
+
+void ScreenModel::dropHiddenRuns()
+{
+    runs_.erase(std::remove_if(runs_.begin(), runs_.end(),
+                               [](const ScreenRun& r) { return r.clip.isEmpty(); }),
+                runs_.end());
+}
+
+/* Copyright (C) 2011-2019 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ */
@@ -0,0 +1,92 @@
+// This is copyrighted software. More information is at the end of this file.
+#pragma once
+#include <QColor>
+#include <QFont>
+#include <QImage>
+#include <QRegion>
+#include <QStaticText>
+#include <vector>
+
+class QPainter;
+
+// One drawing operation on the game screen. Everything is in logical (device independent) pixels.
+struct ScreenRun final
+{
+    enum class Kind
+    {
+        Fill,
+        Text,
+        Image
+    };
+
+    Kind kind;
+
+    // Area the run paints over. For text, this is the background box; glyphs can extend a bit
+    // outside of it.
+    QRect rect;
+
+    // Part of the run that is still visible.
+    QRegion clip;
+
+    // Where text or images are drawn.
+    QPoint pos;
+
+    QColor fg;
+    QColor bg;
+    QFont font;
+
+    // Text is either pre-shaped, or drawn from plain_text if it isn't worth shaping.
+    QStaticText text;
+    QString plain_text;
+
+    QImage image;
+};
+
+/*
+ * A retained copy of the game screen, as the list of runs (text, fills and images) that produced
+ * it. Runs that get painted over or scrolled out are trimmed or dropped, so the list only holds
+ * about as much as is actually visible. This allows rendering the screen again from scratch at a
+ * different size or pixel ratio, instead of scaling or cropping the pixels we have.
+ */
+class ScreenModel final
+{
+public:
+    // Append a run. It hides whatever it covers.
+    void add(ScreenRun run);
+
+    // Move everything inside 'area' up by 'dy' pixels. Whatever moves out of 'area' is gone.
+    void scroll(const QRect& area, int dy);
+
+    void clear()
+    {
+        runs_.clear();
+    }
+
+    // Render all runs, in the order they were added.
+    void paint(QPainter& p) const;
+
+    static void paintRun(QPainter& p, const ScreenRun& run);
+
+private:
+    std::vector<ScreenRun> runs_;
+
+    void dropHiddenRuns();
+};
+
+/* Copyright (C) 2011-2019 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ */
@@ -0,0 +1,81 @@
+// This is copyrighted software. More information is at the end of this file.
+#include "scrollbackbuffer.h"
+
+ScrollbackBuffer::ScrollbackBuffer(const size_t byteBudget)
+    : byte_budget_(byteBudget)
+{ }
+
+size_t ScrollbackBuffer::lineBytes(const QString& line)
+{
+    // Rough, but good enough for a budget.
+    return sizeof(QString) + 32 + line.capacity() * sizeof(QChar);
+}
+
+void ScrollbackBuffer::appendLine(const QString& text)
+{
+    if (chunks_.empty() or chunks_.back().lines.size() == CHUNK_LINES) {
+        chunks_.emplace_back();
+        chunks_.back().lines.reserve(CHUNK_LINES);
+    }
+    auto& chunk = chunks_.back();
+    chunk.lines.push_back(text);
+    chunk.bytes += lineBytes(chunk.lines.back());
+    bytes_ += lineBytes(chunk.lines.back());
+    ++line_count_;
+
+    // Drop the oldest chunks. Only full chunks are ever dropped, so line() can keep finding lines
+    // with a division.
+    while (bytes_ > byte_budget_ and chunks_.size() > 1) {
+        bytes_ -= chunks_.front().bytes;
+        first_id_ += CHUNK_LINES;
+        line_count_ -= CHUNK_LINES;
+        chunks_.pop_front();
+    }
+}
+
+void ScrollbackBuffer::append(const QString& text)
+{
+    int start = 0;
+    while (start < text.length()) {
+        int end = text.indexOf(QLatin1Char('\n'), start);
+        const bool terminated = end >= 0;
+        if (not terminated) {
+            end = text.length();
+        }
+        QString part = text.mid(start, end - start);
+        part.remove(QLatin1Char('\r'));
+
+        if (last_line_open_) {
+            // Continue the open line.
+            auto& chunk = chunks_.back();
+            QString& line = chunk.lines.back();
+            chunk.bytes -= lineBytes(line);
+            bytes_ -= lineBytes(line);
+            line += part;
+            chunk.bytes += lineBytes(line);
+            bytes_ += lineBytes(line);
+        } else {
+            appendLine(part);
+        }
+        last_line_open_ = not terminated;
+        start = end + 1;
+    }
+}
+
+/* Copyright (C) 2011-2019 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ */
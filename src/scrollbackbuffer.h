@@ -0,0 +1,89 @@
+// This is copyrighted software. More information is at the end of this file.
+#pragma once
+#include <QString>
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+/*
+ * Text of the scrollback, as lines in fixed-size chunks. New lines are appended to the last chunk;
+ * when the total size goes over the byte budget, the oldest chunks are dropped. Every line gets an
+ * id that never changes, counting from the first line ever appended, so lines can be found in
+ * constant time no matter how many have been dropped.
+ */
+class ScrollbackBuffer final
+{
+public:
+    explicit ScrollbackBuffer(size_t byteBudget = 16 * 1024 * 1024);
+
+    // Lines are separated by '\n'. Text after the last one is kept as an open line that the next
+    // append continues.
+    void append(const QString& text);
+
+    // Id of the oldest line still in the buffer.
+    quint64 firstLineId() const
+    {
+        return first_id_;
+    }
+
+    // One past the id of the newest line.
+    quint64 endLineId() const
+    {
+        return first_id_ + line_count_;
+    }
+
+    quint64 lineCount() const
+    {
+        return line_count_;
+    }
+
+    // 'id' must be in [firstLineId(), endLineId()).
+    const QString& line(quint64 id) const
+    {
+        const quint64 i = id - first_id_;
+        return chunks_[i / CHUNK_LINES].lines[i % CHUNK_LINES];
+    }
+
+    // Whether the newest line is still open (wasn't terminated by '\n' yet.)
+    bool lastLineOpen() const
+    {
+        return last_line_open_;
+    }
+
+private:
+    static constexpr size_t CHUNK_LINES = 1024;
+
+    struct Chunk final
+    {
+        std::vector<QString> lines;
+        size_t bytes = 0;
+    };
+
+    std::deque<Chunk> chunks_;
+    quint64 first_id_ = 0;
+    quint64 line_count_ = 0;
+    size_t bytes_ = 0;
+    size_t byte_budget_;
+    bool last_line_open_ = false;
+
+    void appendLine(const QString& text);
+    static size_t lineBytes(const QString& line);
+};
+
+/* Copyright (C) 2011-2019 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ */
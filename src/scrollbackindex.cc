@@ -0,0 +1,204 @@
+// This is copyrighted software. More information is at the end of this file.
+#include "scrollbackindex.h"
+
+#include <algorithm>
+#include <iterator>
+
+// Shorter words only match themselves; as prefixes, they'd match most of the scrollback.
+static constexpr int MIN_PREFIX_LENGTH = 3;
+
+// Merges sorted lists of line ids into one, without duplicates.
+static std::vector<quint64> mergeIds(const std::vector<const std::vector<quint64>*>& lists)
+{
+    if (lists.size() == 1) {
+        return *lists.front();
+    }
+    // Position and end of each list, in a min-heap ordered by the id at that position. None of the
+    // lists are empty; words without lines are removed from the index.
+    using Iter = std::vector<quint64>::const_iterator;
+    using Cursor = std::pair<Iter, Iter>;
+    const auto greater = [](const Cursor& a, const Cursor& b) { return *a.first > *b.first; };
+    std::vector<Cursor> heap;
+    heap.reserve(lists.size());
+    for (const auto* list : lists) {
+        heap.emplace_back(list->begin(), list->end());
+    }
+    std::make_heap(heap.begin(), heap.end(), greater);
+
+    std::vector<quint64> ids;
+    while (not heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), greater);
+        auto& cur = heap.back();
+        if (ids.empty() or ids.back() != *cur.first) {
+            ids.push_back(*cur.first);
+        }
+        if (++cur.first == cur.second) {
+            heap.pop_back();
+        } else {
+            std::push_heap(heap.begin(), heap.end(), greater);
+        }
+    }
+    return ids;
+}
+
+ScrollbackIndex::~ScrollbackIndex()
+{
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        quit_ = true;
+    }
+    wake_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+QStringList ScrollbackIndex::words(const QString& text)
+{
+    QStringList list;
+    int start = -1;
+    for (int i = 0; i <= text.length(); ++i) {
+        const bool in_word = i < text.length() and text.at(i).isLetterOrNumber();
+        if (in_word and start < 0) {
+            start = i;
+        } else if (not in_word and start >= 0) {
+            list.append(text.mid(start, i - start).toLower());
+            start = -1;
+        }
+    }
+    return list;
+}
+
+void ScrollbackIndex::addLine(const quint64 id, const QString& text)
+{
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        queue_.emplace_back(id, text);
+        if (not thread_.joinable()) {
+            thread_ = std::thread(&ScrollbackIndex::run, this);
+        }
+    }
+    wake_.notify_one();
+}
+
+void ScrollbackIndex::dropLinesBefore(const quint64 id)
+{
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        drop_before_ = std::max(drop_before_, id);
+    }
+    wake_.notify_one();
+}
+
+void ScrollbackIndex::run()
+{
+    quint64 dropped_before = 0;
+    std::unique_lock<std::mutex> queue_lock(queue_mutex_);
+    while (true) {
+        wake_.wait(queue_lock, [this, dropped_before] {
+            return quit_ or not queue_.empty() or drop_before_ != dropped_before;
+        });
+        if (quit_) {
+            return;
+        }
+        std::vector<std::pair<quint64, QString>> lines;
+        lines.swap(queue_);
+        const quint64 drop_before = drop_before_;
+        queue_lock.unlock();
+
+        // Tokenize without holding the index lock, so searches don't have to wait for it.
+        std::vector<std::pair<quint64, QStringList>> tokenized;
+        tokenized.reserve(lines.size());
+        for (const auto& line : lines) {
+            if (line.first >= drop_before) {
+                tokenized.emplace_back(line.first, words(line.second));
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (const auto& line : tokenized) {
+                for (const auto& word : line.second) {
+                    auto& ids = postings_[word];
+                    // A word that appears more than once in a line is only listed once.
+                    if (ids.empty() or ids.back() != line.first) {
+                        ids.push_back(line.first);
+                    }
+                }
+            }
+            if (drop_before != dropped_before) {
+                for (auto it = postings_.begin(); it != postings_.end();) {
+                    auto& ids = it.value();
+                    ids.erase(ids.begin(), std::lower_bound(ids.begin(), ids.end(), drop_before));
+                    it = ids.empty() ? postings_.erase(it) : std::next(it);
+                }
+            }
+        }
+        dropped_before = drop_before;
+        queue_lock.lock();
+    }
+}
+
+std::vector<quint64> ScrollbackIndex::search(const QString& query) const
+{
+    const QStringList& query_words = words(query);
+    if (query_words.isEmpty()) {
+        return {};
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<quint64> result;
+    bool first = true;
+    for (int i = 0; i < query_words.size(); ++i) {
+        const QString& word = query_words.at(i);
+        std::vector<quint64> ids;
+        if (i == query_words.size() - 1 and word.length() >= MIN_PREFIX_LENGTH
+            and not query.at(query.length() - 1).isSpace()) {
+            // Still being typed. The words it's a prefix of are all in one range of the map, so
+            // merge the lines of those.
+            std::vector<const std::vector<quint64>*> lists;
+            for (auto it = postings_.lowerBound(word);
+                 it != postings_.cend() and it.key().startsWith(word); ++it) {
+                lists.push_back(&it.value());
+            }
+            ids = mergeIds(lists);
+        } else {
+            const auto it = postings_.constFind(word);
+            if (it != postings_.cend()) {
+                ids = it.value();
+            }
+        }
+
+        if (first) {
+            result.swap(ids);
+            first = false;
+        } else {
+            std::vector<quint64> common;
+            std::set_intersection(result.begin(), result.end(), ids.begin(), ids.end(),
+                                  std::back_inserter(common));
+            result.swap(common);
+        }
+        if (result.empty()) {
+            break;
+        }
+    }
+    return result;
+}
+
+/* Copyright (C) 2011-2019 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ */
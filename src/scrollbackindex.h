@@ -0,0 +1,72 @@
+// This is copyrighted software. More information is at the end of this file.
+#pragma once
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/*
+ * Word index over the scrollback, for searching it. Maps each word to the ids of the lines it
+ * appears in (see ScrollbackBuffer.) Lines are handed over as they're completed and get indexed
+ * in a background thread, so the GUI thread only pays for queueing them. Searching only has to
+ * intersect a few sorted lists, which takes about the same time no matter how long the scrollback
+ * is.
+ */
+class ScrollbackIndex final
+{
+public:
+    ~ScrollbackIndex();
+
+    // Queue a line for indexing. Ids must be increasing.
+    void addLine(quint64 id, const QString& text);
+
+    // Forget lines with ids below 'id'.
+    void dropLinesBefore(quint64 id);
+
+    // Ids of the lines (in increasing order) that contain all the words in 'query'. Case doesn't
+    // matter. The last word, if it's at least three characters long, also matches longer words it
+    // is a prefix of, so that searching as the user types finds something before they finish a
+    // word.
+    std::vector<quint64> search(const QString& query) const;
+
+    // Splits text into lowercase words, the same way the index does.
+    static QStringList words(const QString& text);
+
+private:
+    // Word to line ids. Kept sorted by word, so that the words a prefix matches are next to each
+    // other. Only accessed with mutex_ held.
+    QMap<QString, std::vector<quint64>> postings_;
+    mutable std::mutex mutex_;
+
+    // Lines waiting to be indexed.
+    std::vector<std::pair<quint64, QString>> queue_;
+    quint64 drop_before_ = 0;
+    std::mutex queue_mutex_;
+    std::condition_variable wake_;
+    bool quit_ = false;
+    std::thread thread_;
+
+    void run();
+};
+
+/* Copyright (C) 2011-2019 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ */
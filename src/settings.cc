@@ -55,6 +55,7 @@ extern "C" {
 #define SETT_FULLSCREEN_WIDTH QString::fromLatin1("fullscreenWidth")
 #define SETT_TEXT_CURSOR_SHAPE QString::fromLatin1("textCursorShape")
 #define SETT_TEXT_CURSOR_THICKNESS QString::fromLatin1("textCursorThickness")
+#define SETT_WATCHDOG_MS QString::fromLatin1("watchdogMs")
 #define SETT_START_FULLSCREEN QString::fromLatin1("startFullscreen")
 #define SETT_START_WINDOWED QString::fromLatin1("startWindowed")
 
@@ -137,6 +138,7 @@ void Settings::loadFromDisk(SettingsOverrides* ovr)
     cursor_shape = sett.value(SETT_TEXT_CURSOR_SHAPE, QVariant::fromValue(TextCursorShape::Ibeam))
                        .value<TextCursorShape>();
     cursor_thickness = sett.value(SETT_TEXT_CURSOR_THICKNESS, 1).toInt();
+    watchdog_ms = sett.value(SETT_WATCHDOG_MS, 0).toInt();
     sett.endGroup();
 
     sett.beginGroup(SETT_RECENT_GRP);
@@ -271,6 +273,7 @@ void Settings::saveToDisk()
     sett.setValue(SETT_SCRIPT_WRAP, script_wrap);
     sett.setValue(SETT_TEXT_CURSOR_SHAPE, QVariant::fromValue(cursor_shape).toString());
     sett.setValue(SETT_TEXT_CURSOR_THICKNESS, cursor_thickness);
+    sett.setValue(SETT_WATCHDOG_MS, watchdog_ms);
     sett.endGroup();
 
     sett.beginGroup(SETT_RECENT_GRP);
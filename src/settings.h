@@ -53,6 +53,8 @@ public:
     int script_wrap;
     TextCursorShape cursor_shape;
     int cursor_thickness;
+    // Report game routines that run for longer than this without waiting for input. 0 disables.
+    int watchdog_ms;
 
     bool ask_for_gamefile;
     QString last_file_open_dir;